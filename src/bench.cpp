@@ -1,38 +1,59 @@
 #include "bench.hpp"
 
+#include "bitboard.hpp"
 #include "position.hpp"
 #include "search.hpp"
+#include "thread.hpp"
 #include "timeman.hpp"
+#include "ttable.hpp"
+#include "nnue.hpp"
 #include "definition.hpp"
 
 #include <iostream>
 
-void bench() {
-
+inline NodeCounter bench_evaluation(bool use_nnue, TimePoint& elapsed) {
+  // search the bench positions with one evaluation, from empty tables
   SearchLimits limits = {};
   NodeCounter nodes = 0;
+  EvalStats eval_stats;
   Position pos;
 
+  bool enabled = nnue_enabled;
+  nnue_enabled = use_nnue;
+  TT.clear();
+  Threads.clear_eval_caches();
+
   TimePoint top_time = get_time_ms();
   for (int i_fen = 0; i_fen < BENCH_FEN_NB; ++i_fen) {
     std::cout << "Current position fen: " << bench_fens[i_fen] << std::endl;
 
     pos.set(bench_fens[i_fen]);
 
-    ThreadData td;
-
-    td.thread_id = 0;
-    td.depth = 8;
-    td.pos = pos;
-
-    td.limits = limits;
-
-    search_position(td);
-    nodes += td.nodes;
+    Threads.start_search(pos, KeyHistory(), 8, limits);
+    Threads.wait_search();
+    nodes += Threads.nodes_searched();
+    eval_stats += Threads.eval_stats();
   }
+  elapsed = get_time_ms() - top_time;
+
+  nnue_enabled = enabled;
+  TT.clear();
+  Threads.clear_eval_caches();
 
-  TimePoint elapsed = get_time_ms() - top_time;
   double nps = 1000.0 * static_cast<double>(nodes) / static_cast<double>(elapsed);
-  std::cout << "===========================\nTotal time (ms) : " << elapsed << ", \nNodes searched  : " << nodes << ", \nNodes/second    : " << nps << '\n';
-  std::cout << nodes << " nodes " << static_cast<int>(nps) << " nps" << std::endl;
-}
\ No newline at end of file
+  std::cout << "===========================\nEvaluation      : " << (use_nnue ? "nnue" : "hand-crafted")
+            << ", \nTotal time (ms) : " << elapsed << ", \nNodes searched  : " << nodes << ", \nNodes/second    : " << nps << '\n';
+  std::cout << "Evaluations     : " << eval_stats.evaluations << ", saved by the eval cache: " << eval_stats.cache_hits << ", by the TT: " << eval_stats.tt_hits << '\n';
+  std::cout << "Slider attacks  : " << slider_attacks_name() << '\n';
+  return nodes;
+}
+
+void bench() {
+  // the last line reports the evaluation used in games, the network when one is loaded
+  TimePoint elapsed;
+  NodeCounter nodes = bench_evaluation(false, elapsed);
+  if (nnue_loaded)
+    nodes = bench_evaluation(true, elapsed);
+
+  std::cout << nodes << " nodes " << static_cast<int>(1000.0 * static_cast<double>(nodes) / static_cast<double>(elapsed)) << " nps" << std::endl;
+}
@@ -2,6 +2,7 @@
 
 #include "rng.hpp"
 
+#include <cstdlib>    // exit
 #include <cstring>    // memset
 #include <iostream>
 
@@ -10,8 +11,18 @@ Bitboard knight_attacks[SQUARE_NB];
 Bitboard king_attacks[SQUARE_NB];
 Bitboard bishop_masks[SQUARE_NB];
 Bitboard rook_masks[SQUARE_NB];
-Bitboard bishop_attacks[SQUARE_NB][bishop_magic_size];
-Bitboard rook_attacks[SQUARE_NB][rook_magic_size];
+#if defined(USE_PEXT)
+Bitboard* bishop_attacks;
+Bitboard* rook_attacks;
+int bishop_offsets[SQUARE_NB];
+int rook_offsets[SQUARE_NB];
+#else
+Bitboard (*bishop_attacks)[bishop_magic_size];
+Bitboard (*rook_attacks)[rook_magic_size];
+#endif
+Page_Type slider_attacks_page_type;
+Bitboard between_masks[SQUARE_NB][SQUARE_NB];
+Bitboard line_masks[SQUARE_NB][SQUARE_NB];
 
 U64 mask_pawn_attacks(Color side, Square square) {
   U64 attacks = 0ULL;
@@ -66,6 +77,40 @@ Bitboard mask_king_attacks(Square square) {
   return attacks;
 }
 
+const char* slider_attacks_name() {
+#if defined(USE_PEXT)
+  return "pext";
+#else
+  return "magic";
+#endif
+}
+
+void alloc_slider_attacks() {
+#if defined(USE_PEXT)
+  // both compact tables fit in a single huge page
+  constexpr size_t rook_attacks_size = sizeof(Bitboard) * rook_pext_size;
+  constexpr size_t bishop_attacks_size = sizeof(Bitboard) * bishop_pext_size;
+#else
+  // rook attacks fill exactly one huge page, bishop attacks follow
+  constexpr size_t rook_attacks_size = sizeof(Bitboard) * SQUARE_NB * rook_magic_size;
+  constexpr size_t bishop_attacks_size = sizeof(Bitboard) * SQUARE_NB * bishop_magic_size;
+#endif
+
+  char* region = static_cast<char*>(large_page_alloc(rook_attacks_size + bishop_attacks_size, slider_attacks_page_type));
+  if (!region) {
+    std::cout << "info string error: failed to allocate the slider attack tables" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+#if defined(USE_PEXT)
+  rook_attacks = reinterpret_cast<Bitboard*>(region);
+  bishop_attacks = reinterpret_cast<Bitboard*>(region + rook_attacks_size);
+#else
+  rook_attacks = reinterpret_cast<Bitboard (*)[rook_magic_size]>(region);
+  bishop_attacks = reinterpret_cast<Bitboard (*)[bishop_magic_size]>(region + rook_attacks_size);
+#endif
+}
+
 void init_leapers_attacks() {
   for (Square square = Square::FIRST_SQUARE; square <= Square::LAST_SQUARE; ++square) {
     pawn_attacks[Color::WHITE][square] = mask_pawn_attacks(Color::WHITE, square);
@@ -78,6 +123,10 @@ void init_leapers_attacks() {
 }
 
 void init_slider_attacks(Sliding_Piece piece) {
+#if defined(USE_PEXT)
+  int offset = 0;
+#endif
+
   for (Square square = Square::FIRST_SQUARE; square <= Square::LAST_SQUARE; ++square) {
     Bitboard attack_mask;
     int relevant_bits_count;
@@ -96,6 +145,23 @@ void init_slider_attacks(Sliding_Piece piece) {
     int occupancy_subset_size = (1 << relevant_bits_count);
     Bitboard occupancy;
 
+#if defined(USE_PEXT)
+    // the blocks of the squares follow each other, PEXT gives the index of an occupancy in the block
+    if (piece == Sliding_Piece::BISHOP) bishop_offsets[square] = offset;
+    else                                rook_offsets[square] = offset;
+
+    for (int index = 0; index < occupancy_subset_size; index++) {
+      occupancy = get_occupancy_subset(index, relevant_bits_count, attack_mask);
+      int pext_index = offset + int(_pext_u64(occupancy, attack_mask));
+
+      if (piece == Sliding_Piece::BISHOP)
+        bishop_attacks[pext_index] = bishop_attacks_on_the_fly(square, occupancy);
+      else
+        rook_attacks[pext_index] = rook_attacks_on_the_fly(square, occupancy);
+    }
+
+    offset += occupancy_subset_size;
+#else
     // loop over all subset of occupancy to set up the exact attacks and occupancies
     for (int index = 0; index < occupancy_subset_size; index++) {
       if (piece == Sliding_Piece::BISHOP) {
@@ -111,6 +177,7 @@ void init_slider_attacks(Sliding_Piece piece) {
         rook_attacks[square][magic_index] = rook_attacks_on_the_fly(square, occupancy);
       }
     }
+#endif
   }
 }
 
@@ -241,7 +308,7 @@ U64 find_magic_number(Square square, int relevant_bits, Sliding_Piece piece) {
       attacks[index] = rook_attacks_on_the_fly(square, occupancies[index]);
   }
 
-  RNG rng((unsigned int)1804289383);
+  RNG rng(1804289383ULL);
   U64 magic_number;
 
   // test magic numbers loop
@@ -285,10 +352,31 @@ void init_magic_numbers() {
   std::cout << std::endl;
 }
 
+void init_line_masks() {
+  // squares strictly between two aligned squares, and the full line through them, empty if not aligned
+  for (Square square1 = Square::FIRST_SQUARE; square1 <= Square::LAST_SQUARE; ++square1) {
+    for (Square square2 = Square::FIRST_SQUARE; square2 <= Square::LAST_SQUARE; ++square2) {
+      Bitboard bb1 = 1ULL << square1;
+      Bitboard bb2 = 1ULL << square2;
+
+      if (square1 != square2 && (get_bishop_attacks(square1, 0ULL) & bb2)) {
+        between_masks[square1][square2] = get_bishop_attacks(square1, bb2) & get_bishop_attacks(square2, bb1);
+        line_masks[square1][square2] = (get_bishop_attacks(square1, 0ULL) & get_bishop_attacks(square2, 0ULL)) | bb1 | bb2;
+      }
+      else if (square1 != square2 && (get_rook_attacks(square1, 0ULL) & bb2)) {
+        between_masks[square1][square2] = get_rook_attacks(square1, bb2) & get_rook_attacks(square2, bb1);
+        line_masks[square1][square2] = (get_rook_attacks(square1, 0ULL) & get_rook_attacks(square2, 0ULL)) | bb1 | bb2;
+      }
+    }
+  }
+}
+
 void init_attacks() {
+  alloc_slider_attacks();
   init_leapers_attacks();
   init_slider_attacks(Sliding_Piece::BISHOP);
   init_slider_attacks(Sliding_Piece::ROOK);
+  init_line_masks();
 }
 
 Bitboard get_pawn_attacks(Square square, Color side) {
@@ -299,6 +387,19 @@ Bitboard get_knight_attacks(Square square) {
   return knight_attacks[square];
 }
 
+#if defined(USE_PEXT)
+Bitboard get_bishop_attacks(Square square, Bitboard occupancy) {
+  return bishop_attacks[bishop_offsets[square] + _pext_u64(occupancy, bishop_masks[square])];
+}
+
+Bitboard get_rook_attacks(Square square, Bitboard occupancy) {
+  return rook_attacks[rook_offsets[square] + _pext_u64(occupancy, rook_masks[square])];
+}
+
+Bitboard get_queen_attacks(Square square, Bitboard occupancy) {
+  return get_bishop_attacks(square, occupancy) | get_rook_attacks(square, occupancy);
+}
+#else
 Bitboard get_bishop_attacks(Square square, Bitboard occupancy) {
   occupancy &= bishop_masks[square];
   occupancy *= bishop_magic_numbers[square];
@@ -327,11 +428,20 @@ Bitboard get_queen_attacks(Square square, Bitboard occupancy) {
 
   return rook_attacks[square][rook_occupancy] | bishop_attacks[square][bishop_occupancy];
 }
+#endif
 
 Bitboard get_king_attacks(Square square) {
   return king_attacks[square];
 }
 
+Bitboard get_between_bb(Square square1, Square square2) {
+  return between_masks[square1][square2];
+}
+
+Bitboard get_line_bb(Square square1, Square square2) {
+  return line_masks[square1][square2];
+}
+
 int count_bits(Bitboard bitboard) {
   int count = 0;
 
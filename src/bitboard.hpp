@@ -1,6 +1,14 @@
 #pragma once
 
 #include "definition.hpp"
+#include "memory.hpp"
+
+#if defined(USE_PEXT)
+#if !defined(__BMI2__)
+#error "USE_PEXT requires a BMI2 target (-mbmi2 or -march=native on a BMI2 cpu)"
+#endif
+#include <immintrin.h>  // _pext_u64
+#endif
 
 using Bitboard = U64;
 
@@ -48,11 +56,26 @@ extern Bitboard knight_attacks[SQUARE_NB];
 extern Bitboard king_attacks[SQUARE_NB];
 extern Bitboard bishop_masks[SQUARE_NB];
 extern Bitboard rook_masks[SQUARE_NB];
-extern Bitboard bishop_attacks[SQUARE_NB][bishop_magic_size];
-extern Bitboard rook_attacks[SQUARE_NB][rook_magic_size];
+// slider attacks live in one huge page aligned region, randomly accessed at every node
+#if defined(USE_PEXT)
+// PEXT indexed tables are compact, the attacks of a square start at its offset
+extern Bitboard* bishop_attacks;
+extern Bitboard* rook_attacks;
+extern int bishop_offsets[SQUARE_NB];
+extern int rook_offsets[SQUARE_NB];
+#else
+extern Bitboard (*bishop_attacks)[bishop_magic_size];
+extern Bitboard (*rook_attacks)[rook_magic_size];
+#endif
+extern Page_Type slider_attacks_page_type;
+extern Bitboard between_masks[SQUARE_NB][SQUARE_NB];
+extern Bitboard line_masks[SQUARE_NB][SQUARE_NB];
 
+const char* slider_attacks_name();
+void alloc_slider_attacks();
 void init_leapers_attacks();
 void init_slider_attacks(Sliding_Piece piece);
+void init_line_masks();
 
 void init_attacks();
 
@@ -75,6 +98,8 @@ Bitboard get_bishop_attacks(Square square, Bitboard occupancy);
 Bitboard get_rook_attacks(Square square, Bitboard occupancy);
 Bitboard get_queen_attacks(Square square, Bitboard occupancy);
 Bitboard get_king_attacks(Square square);
+Bitboard get_between_bb(Square square1, Square square2);
+Bitboard get_line_bb(Square square1, Square square2);
 
 // relevant occupancy bit count for every square on board
 constexpr int bishop_relevant_bits[SQUARE_NB] = {
@@ -98,6 +123,17 @@ constexpr int rook_relevant_bits[SQUARE_NB] = {
   12, 11, 11, 11, 11, 11, 11, 12
 };
 
+// number of entries of a compact slider table, one block of 2^relevant_bits per square
+constexpr int slider_table_size(const int (&relevant_bits)[SQUARE_NB]) {
+  int size = 0;
+  for (int square = 0; square < SQUARE_NB; square++)
+    size += 1 << relevant_bits[square];
+  return size;
+}
+
+constexpr int bishop_pext_size = slider_table_size(bishop_relevant_bits);
+constexpr int rook_pext_size = slider_table_size(rook_relevant_bits);
+
 // rook magic numbers [square]
 constexpr U64 rook_magic_numbers[SQUARE_NB] = {
   0x8a80104000800020ULL,
@@ -12,18 +12,36 @@ constexpr int MAX_MOVES = 256;
 constexpr int MAX_PLY_GAME = 1000;
 constexpr int MAX_PLY_SEARCH = 64;
 
-constexpr Score INF = 50000;
-constexpr Score MATE_VALUE = 49000;
+// scores fit in 16 bits so that they can be packed in the transposition table
+constexpr Score INF = 32000;
+constexpr Score MATE_VALUE = 31000;
 constexpr Score MATE_IN_MAX_PLY = MATE_VALUE - MAX_PLY_SEARCH;
 constexpr Score DRAW_VALUE = 0;
-constexpr Score NO_VALUE = 50001;
+constexpr Score NO_VALUE = 32001;
 
 constexpr int PIECE_NB = 12;
 constexpr int OCCUPANCY_NB = 3;
 constexpr int COLOR_NB = 2;
 constexpr int SQUARE_NB = 64;
 
+// middle game and end game score pair
+struct ScoreExt
+{
+  Score mg;
+  Score eg;
+};
+
+using Phase = int;
+
+constexpr ScoreExt operator+(const ScoreExt& s1, const ScoreExt& s2) { return { s1.mg + s2.mg, s1.eg + s2.eg }; }
+constexpr ScoreExt operator-(const ScoreExt& s1, const ScoreExt& s2) { return { s1.mg - s2.mg, s1.eg - s2.eg }; }
+constexpr ScoreExt operator+=(ScoreExt& s1, const ScoreExt& s2) { return s1 = s1 + s2; }
+constexpr ScoreExt operator-=(ScoreExt& s1, const ScoreExt& s2) { return s1 = s1 - s2; }
+
+constexpr ScoreExt operator*(int i, const ScoreExt& s1) { return { s1.mg * i, s1.eg * i }; }
+
 using Move = uint32_t; 
+using PackedMove = uint16_t;
 using KillerMoves = Move[2][MAX_PLY_SEARCH];
 using HistoryMoves = int[PIECE_NB][SQUARE_NB];
 
@@ -115,10 +133,6 @@ Rank rank_of(Square s);
 // bishop and rook
 enum Sliding_Piece { ROOK, BISHOP };
 
-// move type
-enum Move_Type { ALL_MOVES, ONLY_CAPTURES };
-
-
 /* castling bits binary representation
    bin     dec
 
@@ -0,0 +1,65 @@
+#include "endgame.hpp"
+
+#include "bitboard.hpp"
+#include "evaluate.hpp"
+
+#include <algorithm>  // std::min std::max
+#include <cstdlib>    // abs
+
+int square_distance(Square s1, Square s2) {
+  return std::max(std::abs(get_rank(s1) - get_rank(s2)), std::abs(get_file(s1) - get_file(s2)));
+}
+
+int square_color(Square square) {
+  // 0 for light squares, 1 for dark squares
+  return (int(get_rank(square)) + int(get_file(square))) & 1;
+}
+
+int push_to_edge(Square square) {
+  // bonus for the weak king the closer it is to the edge
+  int rank_distance = std::min(int(get_rank(square)), 7 - get_rank(square));
+  int file_distance = std::min(int(get_file(square)), 7 - get_file(square));
+  return 90 - (7 * file_distance * file_distance / 2 + 7 * rank_distance * rank_distance / 2);
+}
+
+int push_close(Square s1, Square s2) {
+  // bonus for the strong king the closer it is to the weak king
+  return 140 - 20 * square_distance(s1, s2);
+}
+
+int push_to_corner(Square square, Square bishop_square) {
+  // bonus for the weak king the closer it is to a corner of the bishop color
+  // distance to the a1-h8 diagonal, which is the largest in a8 and h1 (light corners)
+  // mirror the file if the bishop is on the dark squares
+  bool dark_bishop = square_color(bishop_square);
+  int file = dark_bishop ? 7 - get_file(square) : get_file(square);
+  return 60 * std::abs(7 - get_rank(square) - file);
+}
+
+Score evaluate_kxk(Position* pos, Color strong_side) {
+  // mate with a major piece: drive the weak king to the edge with the help of the strong king
+  Square strong_king = get_lsb_index(pos->bitboards[(strong_side == Color::WHITE) ? Piece::WK : Piece::BK]);
+  Square weak_king = get_lsb_index(pos->bitboards[(strong_side == Color::WHITE) ? Piece::BK : Piece::WK]);
+
+  Score material = (strong_side == Color::WHITE) ? pos->psqt.eg : -pos->psqt.eg;
+  Score score = KnownWinValue + material + push_to_edge(weak_king) + push_close(strong_king, weak_king);
+
+  return std::min(score, MATE_IN_MAX_PLY - 1);
+}
+
+Score evaluate_kbnk(Position* pos, Color strong_side) {
+  // mate with bishop and knight: drive the weak king to a corner of the bishop color
+  Square strong_king = get_lsb_index(pos->bitboards[(strong_side == Color::WHITE) ? Piece::WK : Piece::BK]);
+  Square weak_king = get_lsb_index(pos->bitboards[(strong_side == Color::WHITE) ? Piece::BK : Piece::WK]);
+  Square bishop = get_lsb_index(pos->bitboards[(strong_side == Color::WHITE) ? Piece::WB : Piece::BB]);
+
+  return KnownWinValue + KnightValue.eg + BishopValue.eg + push_close(strong_king, weak_king) + push_to_corner(weak_king, bishop);
+}
+
+int scale_opposite_bishops(Position* pos) {
+  // bishops of opposite colors with only pawns left are drawish
+  Square white_bishop = get_lsb_index(pos->bitboards[Piece::WB]);
+  Square black_bishop = get_lsb_index(pos->bitboards[Piece::BB]);
+
+  return (square_color(white_bishop) != square_color(black_bishop)) ? scale_factor_opposite_bishops : scale_factor_normal;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "definition.hpp"
+#include "position.hpp"
+
+// base score of a won endgame, far below the mate scores
+constexpr Score KnownWinValue = 10000;
+
+constexpr int scale_factor_normal = 64;
+constexpr int scale_factor_opposite_bishops = 32;
+
+int square_distance(Square s1, Square s2);
+int square_color(Square square);
+int push_to_edge(Square square);
+int push_close(Square s1, Square s2);
+int push_to_corner(Square square, Square bishop_square);
+
+Score evaluate_kxk(Position* pos, Color strong_side);
+Score evaluate_kbnk(Position* pos, Color strong_side);
+int scale_opposite_bishops(Position* pos);
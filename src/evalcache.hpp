@@ -0,0 +1,50 @@
+#pragma once
+
+#include "definition.hpp"
+
+#include <cstdint>
+
+// number of entries of each thread's evaluation cache, a power of two
+constexpr size_t eval_cache_size = 32768;
+
+// static evaluation of a position, from the side to move point of view
+struct EvalCacheEntry {
+  uint32_t key32;  // upper 32 bits of the hash key, the lower bits select the entry
+  Score eval;
+};
+
+// lossy direct-mapped cache, a colliding position simply replaces the entry
+class EvalCache {
+public:
+  EvalCache() { clear(); }
+
+  void clear() {
+    for (EvalCacheEntry& entry : entries)
+      entry = { 0, NO_VALUE };
+  }
+
+  bool probe(U64 key, Score& eval) const {
+    const EvalCacheEntry& entry = entries[key & (eval_cache_size - 1)];
+    eval = entry.eval;
+    return entry.key32 == uint32_t(key >> 32) && eval != NO_VALUE;
+  }
+
+  void store(U64 key, Score eval) { entries[key & (eval_cache_size - 1)] = { uint32_t(key >> 32), eval }; }
+
+private:
+  EvalCacheEntry entries[eval_cache_size];
+};
+
+// per-search counters of the static evaluations
+struct EvalStats {
+  NodeCounter evaluations = 0;  // full evaluate() calls
+  NodeCounter cache_hits = 0;   // evaluations found in the eval cache
+  NodeCounter tt_hits = 0;      // evaluations found in the transposition table
+};
+
+inline EvalStats& operator+=(EvalStats& s1, const EvalStats& s2) {
+  s1.evaluations += s2.evaluations;
+  s1.cache_hits += s2.cache_hits;
+  s1.tt_hits += s2.tt_hits;
+  return s1;
+}
@@ -1,8 +1,12 @@
 #include "evaluate.hpp"
 
 #include "bitboard.hpp"
+#include "endgame.hpp"
 
 #include <algorithm> // std::clamp
+#ifdef DEBUG
+#include <cassert>
+#endif
 #ifdef TRACE_EVAL
 #include <iostream>
 #define PRINT_SCORE(score) std::cout << "MG score: " << score.mg << " EG score: " << score.eg;
@@ -12,6 +16,8 @@ Bitboard isolated_masks[SQUARE_NB];
 Bitboard white_passed_masks[SQUARE_NB];
 Bitboard black_passed_masks[SQUARE_NB];
 
+ScoreExt psqt_values[PIECE_NB][SQUARE_NB];
+
 void init_evaluation_masks() {
   for (Rank rank = Rank::RANK_8; rank <= Rank::RANK_1; ++rank) {
     for (File file = File::FILE_A; file <= File::FILE_H; ++file) {
@@ -55,8 +61,57 @@ void init_evaluation_masks() {
   }
 }
 
-Score evaluate(Position* pos) {
-  Phase phase = 0;
+void init_psqt_values() {
+  constexpr ScoreExt piece_values[6] = { PawnValue, KnightValue, BishopValue, RookValue, QueenValue, { 0, 0 } };
+
+  for (Piece piece = Piece::WP; piece <= Piece::WK; ++piece) {
+    for (Square square = Square::FIRST_SQUARE; square <= Square::LAST_SQUARE; ++square) {
+      psqt_values[piece][square] = piece_values[piece] + piece_square_tables[piece][square];
+      psqt_values[~piece][square] = ScoreExt{ 0, 0 } - piece_values[piece] - piece_square_tables[piece][mirror_square[square]];
+    }
+  }
+}
+
+ScoreExt compute_psqt(Position* pos, Phase& phase) {
+  // full computation of the incremental psqt score and game phase of the position
+  ScoreExt score = { 0, 0 };
+  phase = 0;
+
+  for (Piece piece = Piece::WP; piece <= Piece::BK; ++piece) {
+    Bitboard bitboard = pos->bitboards[piece];
+    while (bitboard) {
+      Square square = get_lsb_index(bitboard);
+
+      score += psqt_values[piece][square];
+      phase += phase_values[piece];
+
+      pop_bit(bitboard, square);
+    }
+  }
+  return score;
+}
+
+PawnEntry* probe_pawns(Position* pos, PawnTable& pawn_hash) {
+  // probe the pawn structure, evaluate it on a miss
+  PawnEntry* entry = pawn_hash.probe(pos->pawn_key);
+  if (entry->key != pos->pawn_key) {
+    entry->score = evaluate_pawns(pos, entry);
+    entry->key = pos->pawn_key;
+  }
+  return entry;
+}
+
+MaterialEntry* probe_material(Position* pos, MaterialTable& material_hash) {
+  // probe the piece counts, evaluate them on a miss
+  MaterialEntry* entry = material_hash.probe(pos->material_key);
+  if (entry->key != pos->material_key) {
+    evaluate_material(pos, entry);
+    entry->key = pos->material_key;
+  }
+  return entry;
+}
+
+Score evaluate(Position* pos, PawnTable& pawn_hash, MaterialTable& material_hash) {
   ScoreExt score = { 0, 0 };
 
 #ifdef TRACE_EVAL
@@ -64,14 +119,38 @@ Score evaluate(Position* pos) {
   print_board(pos);
 #endif
 
-  score += evaluate_material(pos, phase);
-  score += evaluate_pieces<Piece::WN>(pos);
-  score += evaluate_pieces<Piece::WB>(pos);
-  score += evaluate_pieces<Piece::WR>(pos);
-  score += evaluate_pieces<Piece::WQ>(pos);
-  score += evaluate_pawns(pos);
-  score += evaluate_kings(pos);
+#ifdef DEBUG
+  Phase full_phase;
+  ScoreExt full_psqt = compute_psqt(pos, full_phase);
+  assert(full_psqt.mg == pos->psqt.mg && full_psqt.eg == pos->psqt.eg && full_phase == pos->phase);
+#endif
+
+  MaterialEntry* material = probe_material(pos, material_hash);
+
+  // known draws and endgames
+  if (material->draw)
+    return DRAW_VALUE;
+  if (material->endgame) {
+    Score endgame_score = material->endgame(pos, material->strong_side);
+    return (pos->side == material->strong_side) ? endgame_score : -endgame_score;
+  }
 
+  PawnEntry* pawns = probe_pawns(pos, pawn_hash);
+
+  score += pos->psqt;
+  score += material->score;
+  score += evaluate_pieces<Piece::WN>(pos, pawns);
+  score += evaluate_pieces<Piece::WB>(pos, pawns);
+  score += evaluate_pieces<Piece::WR>(pos, pawns);
+  score += evaluate_pieces<Piece::WQ>(pos, pawns);
+  score += pawns->score;
+  score += evaluate_kings(pos, pawns);
+
+  // scale the end game score of drawish endgames
+  if (material->scale)
+    score.eg = score.eg * material->scale(pos) / scale_factor_normal;
+
+  Phase phase = material->phase;
   Score final_score = (score.mg * phase + score.eg * (PhaseMidGame - phase)) / PhaseMidGame;
 
 #ifdef TRACE_EVAL
@@ -83,7 +162,8 @@ Score evaluate(Position* pos) {
   return (pos->side == Color::WHITE) ? final_score : -final_score;
 }
 
-ScoreExt evaluate_material(Position* pos, Phase& phase) {
+void evaluate_material(Position* pos, MaterialEntry* entry) {
+  // evaluate the piece counts and detect the known endgames
   ScoreExt score = { 0, 0 };
 
   // extract number of pieces for each side
@@ -99,13 +179,6 @@ ScoreExt evaluate_material(Position* pos, Phase& phase) {
   int black_rooks = pos->piece_count[Piece::BR];
   int black_queens = pos->piece_count[Piece::BQ];
   
-  // compute material score
-  score += (white_pawns - black_pawns) * PawnValue;
-  score += (white_knights - black_knights) * KnightValue;
-  score += (white_bishops - black_bishops) * BishopValue;
-  score += (white_rooks - black_rooks) * RookValue;
-  score += (white_queens - black_queens) * QueenValue;
-
   // compute bonuses and penalties
   if (white_bishops > 1) score += BishopPairBonus;
   if (black_bishops > 1) score -= BishopPairBonus;
@@ -120,24 +193,60 @@ ScoreExt evaluate_material(Position* pos, Phase& phase) {
   if (black_pawns == 0) score -= NoPawnPenalty;
 
   // compute phase
-  phase += (white_knights + black_knights) * KnightValue.mg;
-  phase += (white_bishops + black_bishops) * BishopValue.mg;
-  phase += (white_rooks + black_rooks) * RookValue.mg;
-  phase += (white_queens + black_queens) * QueenValue.mg;
-
-  phase = std::clamp(phase, EndGameThreshold, MidGameThreshold);
+  Phase phase = std::clamp(pos->phase, EndGameThreshold, MidGameThreshold);
   phase = (phase - EndGameThreshold) * PhaseMidGame / (MidGameThreshold - EndGameThreshold);
 
+  entry->score = score;
+  entry->phase = phase;
+  entry->draw = false;
+  entry->strong_side = Color::WHITE;
+  entry->endgame = nullptr;
+  entry->scale = nullptr;
+
+  int white_minors = white_knights + white_bishops;
+  int black_minors = black_knights + black_bishops;
+  int white_majors = white_rooks + white_queens;
+  int black_majors = black_rooks + black_queens;
+  bool white_bare = !white_pawns && !white_minors && !white_majors;
+  bool black_bare = !black_pawns && !black_minors && !black_majors;
+
+  // insufficient material: KK, KNK, KBK
+  if (!white_pawns && !black_pawns && !white_majors && !black_majors && white_minors + black_minors <= 1)
+    entry->draw = true;
+
+  // mate with a major piece against a bare king
+  else if (black_bare && !white_pawns && white_majors) {
+    entry->endgame = evaluate_kxk;
+    entry->strong_side = Color::WHITE;
+  }
+  else if (white_bare && !black_pawns && black_majors) {
+    entry->endgame = evaluate_kxk;
+    entry->strong_side = Color::BLACK;
+  }
+
+  // mate with bishop and knight against a bare king
+  else if (black_bare && !white_pawns && !white_majors && white_knights == 1 && white_bishops == 1) {
+    entry->endgame = evaluate_kbnk;
+    entry->strong_side = Color::WHITE;
+  }
+  else if (white_bare && !black_pawns && !black_majors && black_knights == 1 && black_bishops == 1) {
+    entry->endgame = evaluate_kbnk;
+    entry->strong_side = Color::BLACK;
+  }
+
+  // one bishop each and pawns, drawish if the bishops are of opposite colors
+  else if (!white_majors && !black_majors && !white_knights && !black_knights && white_bishops == 1 && black_bishops == 1)
+    entry->scale = scale_opposite_bishops;
+
 #ifdef TRACE_EVAL
-  std::cout << "Material score: "; PRINT_SCORE(score); std::cout << std::endl;
+  std::cout << "Material and psqt score: "; PRINT_SCORE(pos->psqt); std::cout << std::endl;
+  std::cout << "Material bonus score: "; PRINT_SCORE(score); std::cout << std::endl;
   std::cout << "Phase: " << phase << std::endl;
 #endif
-
-  return score;
 }
 
 template <Piece piece>
-ScoreExt evaluate_pieces(Position* pos) {
+ScoreExt evaluate_pieces(Position* pos, const PawnEntry* pawns) {
   constexpr Piece mirror_piece = ~piece;
 
   ScoreExt score = { 0, 0 };
@@ -159,14 +268,13 @@ ScoreExt evaluate_pieces(Position* pos) {
 
     // compute rook on open file bonus
     if constexpr (piece == Piece::WR) {    
-      if ((pos->bitboards[Piece::WP] & get_file_bb(get_file(square))) == 0)
+      if (get_bit(pawns->semi_open_files[Color::WHITE], square))
         score += semi_open_file_score;
 
-      if (((pos->bitboards[Piece::WP] | pos->bitboards[Piece::BP]) & get_file_bb(get_file(square))) == 0)
+      if (get_bit(pawns->semi_open_files[Color::WHITE] & pawns->semi_open_files[Color::BLACK], square))
         score += open_file_score;
     }
 
-    score += piece_square_tables[piece][square];
     score += mobility * mobility_score[piece];
 
     pop_bit(bitboard, square);
@@ -185,14 +293,13 @@ ScoreExt evaluate_pieces(Position* pos) {
 
     // compute rook on open file bonus
     if constexpr (piece == Piece::WR) {    
-      if ((pos->bitboards[Piece::BP] & get_file_bb(get_file(square))) == 0)
+      if (get_bit(pawns->semi_open_files[Color::BLACK], square))
         score -= semi_open_file_score;
 
-      if (((pos->bitboards[Piece::WP] | pos->bitboards[Piece::BP]) & get_file_bb(get_file(square))) == 0)
+      if (get_bit(pawns->semi_open_files[Color::WHITE] & pawns->semi_open_files[Color::BLACK], square))
         score -= open_file_score;
     }
 
-    score -= piece_square_tables[piece][mirror_square[square]];
     score -= mobility * mobility_score[piece];
 
     pop_bit(bitboard, square);
@@ -205,7 +312,7 @@ ScoreExt evaluate_pieces(Position* pos) {
   return score;
 }
 
-ScoreExt evaluate_kings(Position* pos) {
+ScoreExt evaluate_kings(Position* pos, const PawnEntry* pawns) {
   ScoreExt score = { 0, 0 };
 
   Bitboard bitboard;
@@ -215,13 +322,11 @@ ScoreExt evaluate_kings(Position* pos) {
   bitboard = pos->bitboards[Piece::WK];
   square = get_lsb_index(bitboard);
 
-  score += king_table[square];
-
   // open king file penalty
-  if ((pos->bitboards[Piece::WP] & get_file_bb(get_file(square))) == 0)
+  if (get_bit(pawns->semi_open_files[Color::WHITE], square))
     score -= semi_open_file_score;
 
-  if (((pos->bitboards[Piece::WP] | pos->bitboards[Piece::BP]) & get_file_bb(get_file(square))) == 0)
+  if (get_bit(pawns->semi_open_files[Color::WHITE] & pawns->semi_open_files[Color::BLACK], square))
     score -= open_file_score;
 
 
@@ -233,13 +338,11 @@ ScoreExt evaluate_kings(Position* pos) {
   bitboard = pos->bitboards[Piece::BK];
   square = get_lsb_index(bitboard);
 
-  score -= king_table[mirror_square[square]];
-
   // open king file penalty
-  if ((pos->bitboards[Piece::BP] & get_file_bb(get_file(square))) == 0)
+  if (get_bit(pawns->semi_open_files[Color::BLACK], square))
     score += semi_open_file_score;
 
-  if (((pos->bitboards[Piece::WP] | pos->bitboards[Piece::BP]) & get_file_bb(get_file(square))) == 0)
+  if (get_bit(pawns->semi_open_files[Color::WHITE] & pawns->semi_open_files[Color::BLACK], square))
     score += open_file_score;
 
   // king shield bonus
@@ -252,22 +355,38 @@ ScoreExt evaluate_kings(Position* pos) {
   return score;
 }
 
-ScoreExt evaluate_pawns(Position* pos) {
+inline Bitboard fill_up(Bitboard bitboard) {
+  bitboard |= bitboard >> 8;
+  bitboard |= bitboard >> 16;
+  return bitboard | (bitboard >> 32);
+}
+
+inline Bitboard fill_down(Bitboard bitboard) {
+  bitboard |= bitboard << 8;
+  bitboard |= bitboard << 16;
+  return bitboard | (bitboard << 32);
+}
+
+ScoreExt evaluate_pawns(Position* pos, PawnEntry* entry) {
+  // evaluate the pawn structure and fill the open files of the pawn entry
   ScoreExt score = { 0, 0 };
 
   Bitboard bitboard;
   Square square;
   int double_pawns;
 
+  Bitboard white_pawns = pos->bitboards[Piece::WP];
+  Bitboard black_pawns = pos->bitboards[Piece::BP];
+
+  entry->semi_open_files[Color::WHITE] = ~(fill_up(white_pawns) | fill_down(white_pawns));
+  entry->semi_open_files[Color::BLACK] = ~(fill_up(black_pawns) | fill_down(black_pawns));
+
 
   // evaluate white pawns
   bitboard = pos->bitboards[Piece::WP];
   while (bitboard) {
     square = get_lsb_index(bitboard);
 
-    score += pawn_table[square];
-
-
     double_pawns = count_bits(bitboard & get_file_bb(get_file(square)));
     if (double_pawns > 1)
       score += double_pawn_penalty;
@@ -286,8 +405,6 @@ ScoreExt evaluate_pawns(Position* pos) {
   while (bitboard) {
     square = get_lsb_index(bitboard);
 
-    score -= pawn_table[mirror_square[square]];
-
     double_pawns = count_bits(bitboard & get_file_bb(get_file(square)));
     if (double_pawns > 1)
       score -= double_pawn_penalty;
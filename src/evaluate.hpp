@@ -2,6 +2,8 @@
 
 #include "definition.hpp"
 #include "position.hpp"
+#include "pawns.hpp"
+#include "material.hpp"
 
 
 /*
@@ -9,25 +11,8 @@ TODO:
 
 Bad trade penalty as proposed by Robert Hyatt, that is penalizing the material imbalances that are disadvantageous like having three pawns for a piece or a rook for two minors.
 
-Add draw knowledge from insufficient material (e.g. KK, KBK, KNK)
-
 */
 
-struct ScoreExt
-{
-  Score mg;
-  Score eg;
-};
-
-using Phase = int;
-
-constexpr ScoreExt operator+(const ScoreExt& s1, const ScoreExt& s2) { return { s1.mg + s2.mg, s1.eg + s2.eg }; }
-constexpr ScoreExt operator-(const ScoreExt& s1, const ScoreExt& s2) { return { s1.mg - s2.mg, s1.eg - s2.eg }; }
-constexpr ScoreExt operator+=(ScoreExt& s1, const ScoreExt& s2) { return s1 = s1 + s2; }
-constexpr ScoreExt operator-=(ScoreExt& s1, const ScoreExt& s2) { return s1 = s1 - s2; }
-
-constexpr ScoreExt operator*(int i, const ScoreExt& s1) { return { s1.mg * i, s1.eg * i }; }
-
 // ============== Phase ============== // from Stockfish (15.1)
 
 constexpr Phase EndGameThreshold = 3915;
@@ -139,11 +124,26 @@ constexpr ScoreExt king_shield_bonus =        { 5,  5 };
 
 constexpr ScoreExt mobility_score[6] = { S(0, 0), S(0, 0), S(5, 5), S(5, 5), S(5, 5), S(0, 0) };
 
+// non-pawn material counted in the game phase
+constexpr Phase phase_values[PIECE_NB] = {
+  0, KnightValue.mg, BishopValue.mg, RookValue.mg, QueenValue.mg, 0,
+  0, KnightValue.mg, BishopValue.mg, RookValue.mg, QueenValue.mg, 0,
+};
+
+// material plus piece-square value of each piece on each square, from white's point of view
+extern ScoreExt psqt_values[PIECE_NB][SQUARE_NB];
+
 void init_evaluation_masks();
+void init_psqt_values();
+
+ScoreExt compute_psqt(Position* pos, Phase& phase);
+
+PawnEntry* probe_pawns(Position* pos, PawnTable& pawn_hash);
+MaterialEntry* probe_material(Position* pos, MaterialTable& material_hash);
 
-Score evaluate(Position* pos);
-ScoreExt evaluate_material(Position* pos, Phase& phase);
+Score evaluate(Position* pos, PawnTable& pawn_hash, MaterialTable& material_hash);
+void evaluate_material(Position* pos, MaterialEntry* entry);
 template<Piece piece>
-ScoreExt evaluate_pieces(Position* pos);
-ScoreExt evaluate_kings(Position* pos);
-ScoreExt evaluate_pawns(Position* pos);
+ScoreExt evaluate_pieces(Position* pos, const PawnEntry* pawns);
+ScoreExt evaluate_kings(Position* pos, const PawnEntry* pawns);
+ScoreExt evaluate_pawns(Position* pos, PawnEntry* entry);
@@ -3,6 +3,12 @@
 #include "evaluate.hpp"
 #include "perft.hpp"
 #include "uci.hpp"
+#include "ttable.hpp"
+#include "bitboard.hpp"
+#include "memory.hpp"
+#include "search.hpp"
+#include "thread.hpp"
+#include "nnue.hpp"
 
 #include <iostream>
 
@@ -10,8 +16,20 @@ void init_all();
 
 void init_all() {
   init_evaluation_masks();
+  init_psqt_values();
   init_attacks();
   init_random_keys();
+  TT.resize(default_hash_size);
+  Threads.set(default_threads);
+
+  std::cout << "info string transposition table on " << page_type_name(TT.page_type())
+            << ", " << slider_attacks_name() << " slider attacks on " << page_type_name(slider_attacks_page_type) << std::endl;
+
+  // the network is optional, without it the hand-crafted evaluation is used
+  if (nnue_load(nnue_default_file))
+    std::cout << "info string network loaded from " << nnue_default_file << ", " << nnue_simd_name() << " inference" << std::endl;
+  else
+    std::cout << "info string no network found, using the hand-crafted evaluation" << std::endl;
 }
 
 int main(int argc, char **argv) {
@@ -36,27 +54,27 @@ int main(int argc, char **argv) {
 
     print_bitboard(pos->bitboards[Piece::WP]);
     print_bitboard(pos->bitboards[Piece::BP]);
-    perft_test(pos, 6);
+    perft_test(pos, 6, 1);
 
     pos->set(tricky_position);
     print_board(pos);
-    perft_test(pos, 5);
+    perft_test(pos, 5, 1);
 
     pos->set(killer_position);
     print_board(pos);
-    perft_test(pos, 5);
+    perft_test(pos, 5, 1);
 
     pos->set(perft_3);
     print_board(pos);
-    perft_test(pos, 6);
+    perft_test(pos, 6, 1);
 
     pos->set(perft_4);
     print_board(pos);
-    perft_test(pos, 5);
+    perft_test(pos, 5, 1);
 
     pos->set(perft_5);
     print_board(pos);
-    perft_test(pos, 5);
+    perft_test(pos, 5, 1);
   }
   else
     uci_loop(argc, argv);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "definition.hpp"
+#include "position.hpp"
+
+// number of entries of each thread's material hash table, a power of two
+constexpr size_t material_table_size = 8192;
+
+// specialized evaluation of a known endgame, from the point of view of the strong side
+using EndgameFunction = Score (*)(Position* pos, Color strong_side);
+// scale factor of the end game score, out of scale_factor_normal
+using ScaleFunction = int (*)(Position* pos);
+
+// material evaluation, only depends on the piece counts of both sides
+struct MaterialEntry {
+  U64 key;
+  ScoreExt score;
+  Phase phase;
+
+  bool draw;                  // insufficient material to mate
+  Color strong_side;
+  EndgameFunction endgame;    // nullptr if no specialized evaluation applies
+  ScaleFunction scale;        // nullptr if the end game score is not scaled
+};
+
+class MaterialTable {
+public:
+  MaterialEntry* probe(U64 material_key) { return &entries[material_key & (material_table_size - 1)]; }
+
+private:
+  MaterialEntry entries[material_table_size]{};
+};
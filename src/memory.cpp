@@ -0,0 +1,63 @@
+#include "memory.hpp"
+
+#include <cstdlib>    // aligned_alloc free
+
+#if defined(__linux__)
+#include <sys/mman.h>  // mmap madvise
+#elif defined(_WIN32)
+#include <malloc.h>    // _aligned_malloc _aligned_free
+#endif
+
+void* large_page_alloc(size_t size, Page_Type& page_type) {
+  // round the size up to a whole number of huge pages
+  size = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+
+#if defined(__linux__)
+  // explicit huge pages, only available if reserved by the administrator
+  void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (mem != MAP_FAILED) {
+    page_type = Page_Type::HUGE_PAGES;
+    return mem;
+  }
+
+  // otherwise ask for transparent huge pages on a huge page aligned region
+  mem = std::aligned_alloc(huge_page_size, size);
+  if (!mem) return nullptr;
+
+  page_type = (madvise(mem, size, MADV_HUGEPAGE) == 0) ? Page_Type::TRANSPARENT_HUGE_PAGES : Page_Type::NORMAL_PAGES;
+  return mem;
+#elif defined(_WIN32)
+  page_type = Page_Type::NORMAL_PAGES;
+  return _aligned_malloc(size, huge_page_size);
+#else
+  page_type = Page_Type::NORMAL_PAGES;
+  return std::aligned_alloc(huge_page_size, size);
+#endif
+}
+
+void large_page_free(void* mem, size_t size, Page_Type page_type) {
+  if (!mem) return;
+
+#if defined(__linux__)
+  if (page_type == Page_Type::HUGE_PAGES) {
+    size = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+    munmap(mem, size);
+    return;
+  }
+  std::free(mem);
+#elif defined(_WIN32)
+  (void)size; (void)page_type;
+  _aligned_free(mem);
+#else
+  (void)size; (void)page_type;
+  std::free(mem);
+#endif
+}
+
+const char* page_type_name(Page_Type page_type) {
+  switch (page_type) {
+    case Page_Type::HUGE_PAGES:             return "huge pages";
+    case Page_Type::TRANSPARENT_HUGE_PAGES: return "transparent huge pages";
+    default:                                return "normal pages";
+  }
+}
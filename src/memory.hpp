@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+// kind of pages backing a large allocation
+enum Page_Type { NORMAL_PAGES, TRANSPARENT_HUGE_PAGES, HUGE_PAGES };
+
+void* large_page_alloc(size_t size, Page_Type& page_type);
+void large_page_free(void* mem, size_t size, Page_Type page_type);
+
+const char* page_type_name(Page_Type page_type);
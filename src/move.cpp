@@ -15,6 +15,20 @@ bool get_move_double_f(Move move)    { return (move & 0x200000); }
 bool get_move_enpassant_f(Move move) { return (move & 0x400000); }
 bool get_move_castling_f(Move move)  { return (move& 0x800000); }
 
+PackedMove pack_move(Move move) {
+  if (move == UNDEFINED_MOVE)
+    return 0;
+
+  Piece promoted = get_move_promoted(move);
+  PackedMove packed = get_move_source(move) | (get_move_target(move) << 6);
+
+  // promoted pieces are ordered N, B, R, Q for both colors
+  if (promoted)
+    packed |= ((promoted % 6 - Piece::WN) << 12) | 0x4000;
+
+  return packed;
+}
+
 void print_move(Move move) {
   if (move == UNDEFINED_MOVE)
     std::cout << "UNDEFINED_MOVE";
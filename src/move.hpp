@@ -18,6 +18,18 @@
   ==> need minimum 24 bits to store a move, so we use 32 bits (4 bytes)
 */
 
+/* packed move bits binary representation (transposition table)
+
+  binary                                                   hexidecimal
+
+  0000 0000 0011 1111   source square (6 bits)             0x3f
+  0000 1111 1100 0000   target square (6 bits)             0xfc0
+  0011 0000 0000 0000   promoted piece type (2 bits, NBRQ) 0x3000
+  0100 0000 0000 0000   promotion flag (1 bit)             0x4000
+
+  ==> the other fields are recovered from the position with unpack_move
+*/
+
 struct MoveExt
 {
   Move move;
@@ -36,4 +48,6 @@ bool get_move_double_f(Move move);
 bool get_move_enpassant_f(Move move);
 bool get_move_castling_f(Move move);
 
+PackedMove pack_move(Move move);
+
 void print_move(Move move);
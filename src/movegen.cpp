@@ -6,39 +6,112 @@
 
 void generate_moves(Position* pos, MoveList* move_list) {
   move_list->move_count = 0;
+  generate_moves<Gen_Type::ALL_MOVES>(pos, move_list);
+}
+
+template<Gen_Type type>
+void generate_moves(Position* pos, MoveList* move_list) {
+  // append the legal moves of the given type to the list, only the king can move out of a double check
+  if (pos->checkers & (pos->checkers - 1)) {
+    if (pos->side == Color::WHITE) generate_piece_moves<Piece::WK, type>(pos, move_list);
+    else                           generate_piece_moves<Piece::BK, type>(pos, move_list);
+    return;
+  }
 
-  generate_castle_moves(pos, move_list);
+  if ((type == Gen_Type::QUIETS || type == Gen_Type::ALL_MOVES) && !pos->checkers)
+    generate_castle_moves(pos, move_list);
   if (pos->side == Color::WHITE) {
-    generate_pawn_moves<Color::WHITE>(pos, move_list);
-    generate_piece_moves<Piece::WN>(pos, move_list);
-    generate_piece_moves<Piece::WB>(pos, move_list);
-    generate_piece_moves<Piece::WR>(pos, move_list);
-    generate_piece_moves<Piece::WQ>(pos, move_list);
-    generate_piece_moves<Piece::WK>(pos, move_list);
+    generate_pawn_moves<Color::WHITE, type>(pos, move_list);
+    generate_piece_moves<Piece::WN, type>(pos, move_list);
+    generate_piece_moves<Piece::WB, type>(pos, move_list);
+    generate_piece_moves<Piece::WR, type>(pos, move_list);
+    generate_piece_moves<Piece::WQ, type>(pos, move_list);
+    generate_piece_moves<Piece::WK, type>(pos, move_list);
   } else {
-    generate_pawn_moves<Color::BLACK>(pos, move_list);
-    generate_piece_moves<Piece::BN>(pos, move_list);
-    generate_piece_moves<Piece::BB>(pos, move_list);
-    generate_piece_moves<Piece::BR>(pos, move_list);
-    generate_piece_moves<Piece::BQ>(pos, move_list);
-    generate_piece_moves<Piece::BK>(pos, move_list);
+    generate_pawn_moves<Color::BLACK, type>(pos, move_list);
+    generate_piece_moves<Piece::BN, type>(pos, move_list);
+    generate_piece_moves<Piece::BB, type>(pos, move_list);
+    generate_piece_moves<Piece::BR, type>(pos, move_list);
+    generate_piece_moves<Piece::BQ, type>(pos, move_list);
+    generate_piece_moves<Piece::BK, type>(pos, move_list);
   }
 }
 
-template<Piece piece>
+template void generate_moves<Gen_Type::CAPTURES>(Position* pos, MoveList* move_list);
+template void generate_moves<Gen_Type::QUIETS>(Position* pos, MoveList* move_list);
+template void generate_moves<Gen_Type::ALL_MOVES>(Position* pos, MoveList* move_list);
+template void generate_moves<Gen_Type::QUIESCENCE>(Position* pos, MoveList* move_list);
+
+void generate_captures(Position* pos, MoveList* move_list) {
+  // moves searched by the quiescence: captures, en passant and queen promotions
+  move_list->move_count = 0;
+  generate_moves<Gen_Type::QUIESCENCE>(pos, move_list);
+}
+
+inline Square king_square(Position* pos) {
+  return get_lsb_index(pos->bitboards[(pos->side == Color::WHITE) ? Piece::WK : Piece::BK]);
+}
+
+inline Bitboard check_mask(Position* pos, Square king_sq) {
+  // target squares that resolve a single check: capture the checker or block it
+  return pos->checkers ? (get_between_bb(king_sq, get_lsb_index(pos->checkers)) | pos->checkers) : ~0ULL;
+}
+
+inline bool pin_allows(Position* pos, Square king_sq, Square source_square, Square target_square) {
+  // a pinned piece may only move along the line of its pin
+  return !get_bit(pos->pinned, source_square) || get_bit(get_line_bb(king_sq, source_square), target_square);
+}
+
+inline bool king_move_is_safe(Position* pos, Square king_sq, Square target_square) {
+  // sliders see through the king, it cannot step back along the line of a check
+  const Bitboard* enemy = &pos->bitboards[(pos->side == Color::WHITE) ? Piece::BP : Piece::WP];  // pawn to king of the enemy
+  Bitboard occupancy = pos->occupancies[Color::BOTH] ^ (1ULL << king_sq);
+
+  if (get_pawn_attacks(target_square, pos->side) & enemy[0]) return false;
+  if (get_knight_attacks(target_square) & enemy[1]) return false;
+  if (get_king_attacks(target_square) & enemy[5]) return false;
+  if (get_bishop_attacks(target_square, occupancy) & (enemy[2] | enemy[4])) return false;
+  return !(get_rook_attacks(target_square, occupancy) & (enemy[3] | enemy[4]));
+}
+
+inline bool enpassant_is_legal(Position* pos, Square king_sq, Square source_square) {
+  // two pawns leave their squares at once, look for any attack on the king after the capture
+  Color them = ~pos->side;
+  Square capture_square = (pos->side == Color::WHITE) ? shift<Direction::DOWN>(pos->enpassant) : shift<Direction::UP>(pos->enpassant);
+  Bitboard occupancy = (pos->occupancies[Color::BOTH] ^ (1ULL << source_square) ^ (1ULL << capture_square)) | (1ULL << pos->enpassant);
+
+  return !(attackers_to(pos, king_sq, occupancy) & pos->occupancies[them] & ~(1ULL << capture_square));
+}
+
+template<Piece piece, Gen_Type type>
 void generate_piece_moves(Position* pos, MoveList* move_list) {
+  constexpr bool king = (piece == Piece::WK || piece == Piece::BK);
+
   Bitboard bb = pos->bitboards[piece];
   Bitboard attacks;
   Square source_square, target_square;
+  Square king_sq = king_square(pos);
+
+  Bitboard targets = (type == Gen_Type::CAPTURES || type == Gen_Type::QUIESCENCE) ? pos->occupancies[~pos->side] :
+                     (type == Gen_Type::QUIETS)   ? ~pos->occupancies[Color::BOTH] : ~pos->occupancies[pos->side];
+  if (!king)
+    targets &= check_mask(pos, king_sq);
 
   while (bb) {
     source_square = get_lsb_index(bb);
-    attacks = get_attacks_bb<piece>(source_square, pos->occupancies[Color::BOTH]) & ((pos->side == Color::WHITE) ? ~pos->occupancies[Color::WHITE] : ~pos->occupancies[Color::BLACK]);
+    attacks = get_attacks_bb<piece>(source_square, pos->occupancies[Color::BOTH]) & targets;
+    if (!king && get_bit(pos->pinned, source_square))
+      attacks &= get_line_bb(king_sq, source_square);
 
     while (attacks)
     {
       target_square = get_lsb_index(attacks);
 
+      if (king && !king_move_is_safe(pos, king_sq, target_square)) {
+        pop_bit(attacks, target_square);
+        continue;
+      }
+
       if (!get_bit((pos->side == Color::WHITE) ? pos->occupancies[Color::BLACK] : pos->occupancies[Color::WHITE], target_square))
         move_push(move_list, encode_move(source_square, target_square, piece, (Piece)0, 0, 0, 0, 0));
       else
@@ -50,7 +123,17 @@ void generate_piece_moves(Position* pos, MoveList* move_list) {
   }
 }
 
-template <Color c>
+template <Color c, Gen_Type type>
+inline void push_promotions(MoveList* move_list, Square source_square, Square target_square, int capture_f) {
+  // quiescence only looks at queen promotions
+  constexpr Piece piece = (c == Color::WHITE) ? Piece::WP : Piece::BP;
+  const Piece* promotions = (c == Color::WHITE) ? WhitePromPiece : BlackPromPiece;
+
+  for (int idx = (type == Gen_Type::QUIESCENCE) ? 3 : 0; idx < 4; idx++)
+    move_push(move_list, encode_move(source_square, target_square, piece, promotions[idx], capture_f, 0, 0, 0));
+}
+
+template <Color c, Gen_Type type>
 void generate_pawn_moves(Position* pos, MoveList* move_list) {
   constexpr Piece piece = (c == Color::WHITE) ? Piece::WP : Piece::BP;
   constexpr Direction forward  = (c == Color::WHITE) ? Direction::UP : Direction::DOWN;
@@ -65,67 +148,79 @@ void generate_pawn_moves(Position* pos, MoveList* move_list) {
   Bitboard emptySquares = ~pos->occupancies[Color::BOTH];
   Bitboard enemies = (pos->side == Color::WHITE) ? pos->occupancies[Color::BLACK] : pos->occupancies[Color::WHITE];
 
+  Square king_sq = king_square(pos);
+  Bitboard targets = check_mask(pos, king_sq);
+
   Square source_square, target_square;
 
   Bitboard b1, b2, b3;
 
   // Quiet Move
-  b1 = shift<forward>(pawnsNotOn7) & emptySquares; // One forward
-  b2 = shift<forward>(b1 & RelativeRank3) & emptySquares; // Double push on second rank = (one forward rank 2 + one forward rank 3)
-  while (b1) {
-    target_square = get_lsb_index(b1);
-    source_square = shift<backward>(target_square);
-    move_push(move_list, encode_move(source_square, target_square, piece, (Piece)0, 0, 0, 0, 0));
-    pop_bit(b1, target_square);
-  }
+  if (type == Gen_Type::QUIETS || type == Gen_Type::ALL_MOVES) {
+    b1 = shift<forward>(pawnsNotOn7) & emptySquares; // One forward
+    b2 = shift<forward>(b1 & RelativeRank3) & emptySquares & targets; // Double push on second rank = (one forward rank 2 + one forward rank 3)
+    b1 &= targets;
+    while (b1) {
+      target_square = get_lsb_index(b1);
+      source_square = shift<backward>(target_square);
+      if (pin_allows(pos, king_sq, source_square, target_square))
+        move_push(move_list, encode_move(source_square, target_square, piece, (Piece)0, 0, 0, 0, 0));
+      pop_bit(b1, target_square);
+    }
 
-  while (b2) {
-    target_square = get_lsb_index(b2);
-    source_square = shift<backward>(shift<backward>(target_square));
-    move_push(move_list, encode_move(source_square, target_square, piece, (Piece)0, 0, 1, 0, 0));
-    pop_bit(b2, target_square);
+    while (b2) {
+      target_square = get_lsb_index(b2);
+      source_square = shift<backward>(shift<backward>(target_square));
+      if (pin_allows(pos, king_sq, source_square, target_square))
+        move_push(move_list, encode_move(source_square, target_square, piece, (Piece)0, 0, 1, 0, 0));
+      pop_bit(b2, target_square);
+    }
   }
 
-  // Promotions and underpromotions
+  if (type == Gen_Type::QUIETS)
+    return;
+
+  // Promotions and underpromotions, generated with the captures
   if (pawnsOn7) {
-    b1 = shift<Direction::RIGHT>(shift<forward>(pawnsOn7)) & enemies; // capture promotion
-    b2 = shift<Direction::LEFT>(shift<forward>(pawnsOn7)) & enemies; // capture promotion
-    b3 = shift<forward>(pawnsOn7) & emptySquares; // forward promotion
+    b1 = shift<Direction::RIGHT>(shift<forward>(pawnsOn7)) & enemies & targets; // capture promotion
+    b2 = shift<Direction::LEFT>(shift<forward>(pawnsOn7)) & enemies & targets; // capture promotion
+    b3 = shift<forward>(pawnsOn7) & emptySquares & targets; // forward promotion
 
     while (b1) {
       target_square = get_lsb_index(b1);
       source_square = shift<Direction::LEFT>(shift<backward>(target_square));
-      for (auto piece_prom : (pos->side == Color::WHITE) ? WhitePromPiece : BlackPromPiece)
-        move_push(move_list, encode_move(source_square, target_square, piece, piece_prom, 1, 0, 0, 0));            
+      if (pin_allows(pos, king_sq, source_square, target_square))
+        push_promotions<c, type>(move_list, source_square, target_square, 1);
       pop_bit(b1, target_square);
     }
 
     while (b2) {
       target_square = get_lsb_index(b2);
       source_square = shift<Direction::RIGHT>(shift<backward>(target_square));
-      for (auto piece_prom : (pos->side == Color::WHITE) ? WhitePromPiece : BlackPromPiece)
-        move_push(move_list, encode_move(source_square, target_square, piece, piece_prom, 1, 0, 0, 0));            
+      if (pin_allows(pos, king_sq, source_square, target_square))
+        push_promotions<c, type>(move_list, source_square, target_square, 1);
       pop_bit(b2, target_square);
     }
 
     while (b3) {
       target_square = get_lsb_index(b3);
       source_square = shift<backward>(target_square);
-      for (auto piece_prom : (pos->side == Color::WHITE) ? WhitePromPiece : BlackPromPiece)
-        move_push(move_list, encode_move(source_square, target_square, piece, piece_prom, 0, 0, 0, 0));            
+      if (pin_allows(pos, king_sq, source_square, target_square))
+        push_promotions<c, type>(move_list, source_square, target_square, 0);
       pop_bit(b3, target_square);
     }
   }
 
   // Standard and en passant captures
-  b1 = shift<Direction::RIGHT>(shift<forward>(pawnsNotOn7)) & enemies;
-  b2 = shift<Direction::LEFT>(shift<forward>(pawnsNotOn7)) & enemies;
+  b1 = shift<Direction::RIGHT>(shift<forward>(pawnsNotOn7)) & enemies & targets;
+  b2 = shift<Direction::LEFT>(shift<forward>(pawnsNotOn7)) & enemies & targets;
 
   while (b1)
   {
     target_square = get_lsb_index(b1);
     source_square = shift<Direction::LEFT>(shift<backward>(target_square));
-    move_push(move_list, encode_move(source_square, target_square, piece, (Piece)0, 1, 0, 0, 0));            
+    if (pin_allows(pos, king_sq, source_square, target_square))
+      move_push(move_list, encode_move(source_square, target_square, piece, (Piece)0, 1, 0, 0, 0));
     pop_bit(b1, target_square);
   }
 
@@ -133,7 +228,8 @@ void generate_pawn_moves(Position* pos, MoveList* move_list) {
   {
     target_square = get_lsb_index(b2);
     source_square = shift<Direction::RIGHT>(shift<backward>(target_square));
-    move_push(move_list, encode_move(source_square, target_square, piece, (Piece)0, 1, 0, 0, 0));            
+    if (pin_allows(pos, king_sq, source_square, target_square))
+      move_push(move_list, encode_move(source_square, target_square, piece, (Piece)0, 1, 0, 0, 0));
     pop_bit(b2, target_square);
   }
 
@@ -143,25 +239,102 @@ void generate_pawn_moves(Position* pos, MoveList* move_list) {
     while (b1)
     {
       source_square = get_lsb_index(b1);
-      move_push(move_list, encode_move(source_square, pos->enpassant, piece, (Piece)0, 0, 0, 1, 0));            
+      if (enpassant_is_legal(pos, king_sq, source_square))
+        move_push(move_list, encode_move(source_square, pos->enpassant, piece, (Piece)0, 0, 0, 1, 0));
       pop_bit(b1, source_square);
     }
   }
 }
 
+bool is_pseudo_legal(Position* pos, Move move) {
+  // check a move that was not generated in this position (hash move, killer) before it is made
+  if (move == UNDEFINED_MOVE) return false;
+
+  Square source_square = get_move_source(move);
+  Square target_square = get_move_target(move);
+  Piece piece = get_move_piece(move);
+  Piece promoted = get_move_promoted(move);
+  Piece captured = pos->board[target_square];
+
+  // the moving piece stands on the source square and belongs to the side to move
+  if (pos->board[source_square] != piece || !get_bit(pos->occupancies[pos->side], source_square))
+    return false;
+
+  // castling is rare, compare with the generated castling moves
+  if (get_move_castling_f(move)) {
+    MoveList castle_list;
+    generate_castle_moves(pos, &castle_list);
+    for (int count = 0; count < castle_list.move_count; count++)
+      if (castle_list.moves[count].move == move) return true;
+    return false;
+  }
+
+  // the capture flag matches the target square
+  if (get_bit(pos->occupancies[pos->side], target_square)) return false;
+  if (get_move_capture_f(move) != (captured != Piece::NO_PIECE)) return false;
+
+  if (piece == Piece::WP || piece == Piece::BP) {
+    constexpr Bitboard last_ranks = RANK_1_BB | RANK_8_BB;
+    int forward = (pos->side == Color::WHITE) ? Direction::UP : Direction::DOWN;
+
+    if ((promoted != (Piece)0) != bool(get_bit(last_ranks, target_square))) return false;
+
+    if (get_move_enpassant_f(move))
+      return target_square == pos->enpassant && get_bit(get_pawn_attacks(source_square, pos->side), target_square);
+    if (get_move_capture_f(move))
+      return get_bit(get_pawn_attacks(source_square, pos->side), target_square) && !get_move_double_f(move);
+    if (get_move_double_f(move))
+      return target_square == source_square + 2 * forward
+          && get_bit((pos->side == Color::WHITE) ? RANK_2_BB : RANK_7_BB, source_square)
+          && !get_bit(pos->occupancies[Color::BOTH], Square(source_square + forward))
+          && !get_bit(pos->occupancies[Color::BOTH], target_square);
+    return target_square == source_square + forward && !get_bit(pos->occupancies[Color::BOTH], target_square);
+  }
+
+  if (promoted || get_move_double_f(move) || get_move_enpassant_f(move)) return false;
+
+  Bitboard attacks;
+  switch (piece) {
+    case Piece::WN: case Piece::BN: attacks = get_knight_attacks(source_square); break;
+    case Piece::WB: case Piece::BB: attacks = get_bishop_attacks(source_square, pos->occupancies[Color::BOTH]); break;
+    case Piece::WR: case Piece::BR: attacks = get_rook_attacks(source_square, pos->occupancies[Color::BOTH]); break;
+    case Piece::WQ: case Piece::BQ: attacks = get_queen_attacks(source_square, pos->occupancies[Color::BOTH]); break;
+    default:                        attacks = get_king_attacks(source_square); break;
+  }
+  return get_bit(attacks, target_square);
+}
+
+bool is_legal(Position* pos, Move move) {
+  // check that a pseudo-legal move does not leave the king in check, generated moves are always legal
+  Square source_square = get_move_source(move);
+  Square target_square = get_move_target(move);
+  Piece piece = get_move_piece(move);
+  Square king_sq = king_square(pos);
+
+  // castling moves are only accepted when they match a generated one
+  if (get_move_castling_f(move)) return true;
+  if (piece == Piece::WK || piece == Piece::BK) return king_move_is_safe(pos, king_sq, target_square);
+  if (get_move_enpassant_f(move)) return enpassant_is_legal(pos, king_sq, source_square);
+
+  if (pos->checkers & (pos->checkers - 1)) return false;
+  return get_bit(check_mask(pos, king_sq), target_square) && pin_allows(pos, king_sq, source_square, target_square);
+}
+
 void generate_castle_moves(Position* pos, MoveList* move_list) {
   if (pos->side == Color::WHITE){
     if (pos->castle_rights & Castle_Right::WOO) {
       if (!get_bit(pos->occupancies[Color::BOTH], Square::F1) && 
           !get_bit(pos->occupancies[Color::BOTH], Square::G1) &&
           !is_square_attacked(pos, Square::E1, Color::BLACK)  &&
-          !is_square_attacked(pos, Square::F1, Color::BLACK))
+          !is_square_attacked(pos, Square::F1, Color::BLACK)  &&
+          !is_square_attacked(pos, Square::G1, Color::BLACK))
             move_push(move_list, encode_move(Square::E1, Square::G1, Piece::WK, (Piece)0, 0, 0, 0, 1));
     }
     if (pos->castle_rights & Castle_Right::WOOO) {
       if (!get_bit(pos->occupancies[Color::BOTH], Square::B1) && 
           !get_bit(pos->occupancies[Color::BOTH], Square::C1) &&
           !get_bit(pos->occupancies[Color::BOTH], Square::D1) &&
+          !is_square_attacked(pos, Square::C1, Color::BLACK)  &&
           !is_square_attacked(pos, Square::D1, Color::BLACK)  &&
           !is_square_attacked(pos, Square::E1, Color::BLACK))
             move_push(move_list, encode_move(Square::E1, Square::C1, Piece::WK, (Piece)0, 0, 0, 0, 1));
@@ -172,13 +345,15 @@ void generate_castle_moves(Position* pos, MoveList* move_list) {
       if (!get_bit(pos->occupancies[Color::BOTH], Square::F8) && 
           !get_bit(pos->occupancies[Color::BOTH], Square::G8) &&
           !is_square_attacked(pos, Square::E8, Color::WHITE)  &&
-          !is_square_attacked(pos, Square::F8, Color::WHITE))
+          !is_square_attacked(pos, Square::F8, Color::WHITE)  &&
+          !is_square_attacked(pos, Square::G8, Color::WHITE))
             move_push(move_list, encode_move(Square::E8, Square::G8, Piece::BK, (Piece)0, 0, 0, 0, 1));
     }
     if (pos->castle_rights & Castle_Right::BOOO) {
       if (!get_bit(pos->occupancies[Color::BOTH], Square::B8) &&
           !get_bit(pos->occupancies[Color::BOTH], Square::C8) && 
           !get_bit(pos->occupancies[Color::BOTH], Square::D8) &&
+          !is_square_attacked(pos, Square::C8, Color::WHITE)  &&
           !is_square_attacked(pos, Square::D8, Color::WHITE)  &&
           !is_square_attacked(pos, Square::E8, Color::WHITE))
             move_push(move_list, encode_move(Square::E8, Square::C8, Piece::BK, (Piece)0, 0, 0, 0, 1));
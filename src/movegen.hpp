@@ -4,17 +4,25 @@
 #include "position.hpp"
 #include "move.hpp"
 
+// moves produced by a generator, the captures include the promotions, only queen ones for the quiescence
+enum Gen_Type { CAPTURES, QUIETS, ALL_MOVES, QUIESCENCE };
+
 struct MoveList {
 
   MoveExt moves[MAX_MOVES];
   int move_count = 0;
 };
 
-template<Piece piece>
+template<Piece piece, Gen_Type type>
 void generate_piece_moves(Position* pos, MoveList* move_list);
 void generate_moves(Position* pos, MoveList* move_list);
-template<Color c>
+void generate_captures(Position* pos, MoveList* move_list);
+template<Gen_Type type>
+void generate_moves(Position* pos, MoveList* move_list);
+template<Color c, Gen_Type type>
 void generate_pawn_moves(Position* pos, MoveList* move_list);
+bool is_pseudo_legal(Position* pos, Move move);
+bool is_legal(Position* pos, Move move);
 void generate_castle_moves(Position* pos, MoveList* move_list);
 void move_push(MoveList* move_list, Move move);
 
@@ -0,0 +1,256 @@
+#include "nnue.hpp"
+#include "move.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+NNUEWeights nnue_weights;
+bool nnue_loaded = false;
+bool nnue_enabled = true;
+U64 nnue_checksum = 0;
+
+inline U64 weights_checksum() {
+  // FNV-1a over the bytes of the weights
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&nnue_weights);
+  U64 checksum = 0xcbf29ce484222325ULL;
+  for (size_t idx = 0; idx < sizeof(nnue_weights); idx++)
+    checksum = (checksum ^ bytes[idx]) * 0x100000001b3ULL;
+  return checksum;
+}
+
+bool nnue_load(const std::string& path) {
+  // return false if the file is missing or does not match the architecture, a truncated file unloads the network
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+
+  NNUEFileHeader header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || strncmp(header.magic, "TCENNUE", 8) || header.version != nnue_version
+      || header.buckets != nnue_buckets || header.features != nnue_features || header.hidden != nnue_hidden)
+    return false;
+
+  nnue_loaded = false;
+  file.read(reinterpret_cast<char*>(nnue_weights.ft_weights), sizeof(nnue_weights.ft_weights));
+  file.read(reinterpret_cast<char*>(nnue_weights.ft_biases), sizeof(nnue_weights.ft_biases));
+  file.read(reinterpret_cast<char*>(nnue_weights.out_weights), sizeof(nnue_weights.out_weights));
+  file.read(reinterpret_cast<char*>(&nnue_weights.out_bias), sizeof(nnue_weights.out_bias));
+  if (!file) return false;
+
+  nnue_checksum = weights_checksum();
+  nnue_loaded = true;
+  return true;
+}
+
+bool nnue_active() {
+  return nnue_loaded && nnue_enabled;
+}
+
+U64 eval_id() {
+  // identifies the evaluation behind the static evals stored in the TT, 0 for the hand-crafted one
+  return nnue_active() ? nnue_checksum : 0;
+}
+
+const char* nnue_simd_name() {
+#if defined(__AVX2__)
+  return "avx2";
+#elif defined(__SSE4_1__)
+  return "sse4.1";
+#else
+  return "scalar";
+#endif
+}
+
+inline int feature_index(Color perspective, int bucket, Piece piece, Square square) {
+  // black sees the board flipped, with the colors of the pieces swapped
+  if (perspective == Color::BLACK) {
+    piece = ~piece;
+    square = Square(square ^ 56);
+  }
+
+  return bucket * nnue_features + piece * SQUARE_NB + square;
+}
+
+inline int king_bucket(Color perspective, Square king_square) {
+  return king_buckets[perspective == Color::WHITE ? king_square : king_square ^ 56];
+}
+
+inline int king_bucket(Position* pos, Color perspective) {
+  return king_bucket(perspective, get_lsb_index(pos->bitboards[perspective == Color::WHITE ? Piece::WK : Piece::BK]));
+}
+
+// feature transformer kernels, the accumulator and weight rows are 64 byte aligned
+
+inline void add_feature(int16_t* acc, int index) {
+  const int16_t* weights = nnue_weights.ft_weights[index];
+#if defined(__AVX2__)
+  for (int i = 0; i < nnue_hidden; i += 16) {
+    __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc + i));
+    __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_add_epi16(a, w));
+  }
+#elif defined(__SSE4_1__)
+  for (int i = 0; i < nnue_hidden; i += 8) {
+    __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(acc + i));
+    __m128i w = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+    _mm_store_si128(reinterpret_cast<__m128i*>(acc + i), _mm_add_epi16(a, w));
+  }
+#else
+  for (int i = 0; i < nnue_hidden; i++)
+    acc[i] += weights[i];
+#endif
+}
+
+inline void sub_feature(int16_t* acc, int index) {
+  const int16_t* weights = nnue_weights.ft_weights[index];
+#if defined(__AVX2__)
+  for (int i = 0; i < nnue_hidden; i += 16) {
+    __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc + i));
+    __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_sub_epi16(a, w));
+  }
+#elif defined(__SSE4_1__)
+  for (int i = 0; i < nnue_hidden; i += 8) {
+    __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(acc + i));
+    __m128i w = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+    _mm_store_si128(reinterpret_cast<__m128i*>(acc + i), _mm_sub_epi16(a, w));
+  }
+#else
+  for (int i = 0; i < nnue_hidden; i++)
+    acc[i] -= weights[i];
+#endif
+}
+
+inline int32_t output_dot(const int16_t* acc, const int8_t* weights) {
+  // sum of clipped ReLU activations times int8 weights, fits in int32 for any input
+#if defined(__AVX2__)
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i qa = _mm256_set1_epi16(nnue_qa);
+  __m256i sum = _mm256_setzero_si256();
+  for (int i = 0; i < nnue_hidden; i += 16) {
+    __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc + i));
+    a = _mm256_min_epi16(_mm256_max_epi16(a, zero), qa);
+    __m256i w = _mm256_cvtepi8_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(weights + i)));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, w));
+  }
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  s = _mm_hadd_epi32(s, s);
+  s = _mm_hadd_epi32(s, s);
+  return _mm_cvtsi128_si32(s);
+#elif defined(__SSE4_1__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i qa = _mm_set1_epi16(nnue_qa);
+  __m128i sum = _mm_setzero_si128();
+  for (int i = 0; i < nnue_hidden; i += 8) {
+    __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(acc + i));
+    a = _mm_min_epi16(_mm_max_epi16(a, zero), qa);
+    __m128i w = _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(weights + i)));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(a, w));
+  }
+  sum = _mm_hadd_epi32(sum, sum);
+  sum = _mm_hadd_epi32(sum, sum);
+  return _mm_cvtsi128_si32(sum);
+#else
+  int32_t sum = 0;
+  for (int i = 0; i < nnue_hidden; i++)
+    sum += std::clamp<int32_t>(acc[i], 0, nnue_qa) * weights[i];
+  return sum;
+#endif
+}
+
+void NNUEState::reset(Position* pos) {
+  // empty refresh cache, the network may have changed since the last search
+  for (Color perspective : { Color::WHITE, Color::BLACK }) {
+    for (int bucket = 0; bucket < nnue_buckets; bucket++) {
+      RefreshEntry& entry = refresh_cache[perspective][bucket];
+      memcpy(entry.values, nnue_weights.ft_biases, sizeof(entry.values));
+      memset(entry.bitboards, 0, sizeof(entry.bitboards));
+    }
+  }
+
+  current = 0;
+  refresh(pos, Color::WHITE);
+  refresh(pos, Color::BLACK);
+}
+
+void NNUEState::refresh(Position* pos, Color perspective) {
+  // update the cached accumulator of the king bucket with the pieces that differ, then copy it
+  int bucket = king_bucket(pos, perspective);
+  RefreshEntry& entry = refresh_cache[perspective][bucket];
+
+  for (int piece = Piece::WP; piece <= Piece::BK; piece++) {
+    Bitboard removed = entry.bitboards[piece] & ~pos->bitboards[piece];
+    Bitboard added = pos->bitboards[piece] & ~entry.bitboards[piece];
+
+    while (removed) {
+      Square square = get_lsb_index(removed);
+      sub_feature(entry.values, feature_index(perspective, bucket, Piece(piece), square));
+      pop_bit(removed, square);
+    }
+    while (added) {
+      Square square = get_lsb_index(added);
+      add_feature(entry.values, feature_index(perspective, bucket, Piece(piece), square));
+      pop_bit(added, square);
+    }
+    entry.bitboards[piece] = pos->bitboards[piece];
+  }
+
+  memcpy(stack[current].values[perspective], entry.values, sizeof(entry.values));
+}
+
+void NNUEState::push(Position* pos, Move move, Piece captured) {
+  // accumulators of the position after the move, from the ones of the parent
+  Square source_square = get_move_source(move);
+  Square target_square = get_move_target(move);
+  Piece piece = get_move_piece(move);
+  Piece promoted = get_move_promoted(move);
+
+  const Accumulator& parent = stack[current];
+  Accumulator& child = stack[++current];
+
+  Square capture_square = target_square;
+  if (get_move_enpassant_f(move))
+    capture_square = (piece == Piece::WP) ? shift<Direction::DOWN>(target_square) : shift<Direction::UP>(target_square);
+
+  Piece rook = Piece::NO_PIECE;
+  Square rook_source = Square::NO_SQUARE, rook_target = Square::NO_SQUARE;
+  if (get_move_castling_f(move))
+    castling_rook(target_square, rook, rook_source, rook_target);
+
+  for (Color perspective : { Color::WHITE, Color::BLACK }) {
+    // a king changing bucket invalidates all features of its side
+    if ((piece == Piece::WK || piece == Piece::BK) && (piece == Piece::WK) == (perspective == Color::WHITE)
+        && king_bucket(perspective, source_square) != king_bucket(perspective, target_square)) {
+      refresh(pos, perspective);
+      continue;
+    }
+
+    int bucket = king_bucket(pos, perspective);
+    int16_t* acc = child.values[perspective];
+    memcpy(acc, parent.values[perspective], sizeof(child.values[perspective]));
+
+    sub_feature(acc, feature_index(perspective, bucket, piece, source_square));
+    add_feature(acc, feature_index(perspective, bucket, promoted ? promoted : piece, target_square));
+    if (captured != Piece::NO_PIECE)
+      sub_feature(acc, feature_index(perspective, bucket, captured, capture_square));
+    if (rook != Piece::NO_PIECE) {
+      sub_feature(acc, feature_index(perspective, bucket, rook, rook_source));
+      add_feature(acc, feature_index(perspective, bucket, rook, rook_target));
+    }
+  }
+}
+
+Score NNUEState::evaluate(Position* pos) const {
+  // evaluation from the side to move, its half of the hidden layer first
+  const Accumulator& acc = stack[current];
+  int32_t output = nnue_weights.out_bias
+                 + output_dot(acc.values[pos->side], nnue_weights.out_weights)
+                 + output_dot(acc.values[~pos->side], nnue_weights.out_weights + nnue_hidden);
+
+  int64_t score = int64_t(output) * nnue_scale / (nnue_qa * nnue_qb);
+  return Score(std::clamp<int64_t>(score, -MATE_IN_MAX_PLY + 1, MATE_IN_MAX_PLY - 1));
+}
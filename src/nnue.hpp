@@ -0,0 +1,95 @@
+#pragma once
+
+#include "definition.hpp"
+#include "position.hpp"
+#include "bitboard.hpp"
+
+#include <cstdint>
+#include <string>
+
+/* network architecture
+
+  768 inputs per king bucket (12 pieces x 64 squares, relative to the perspective)
+    -> 256 int16 accumulator per perspective (feature transformer)
+    -> clipped ReLU [0, nnue_qa], side to move half first
+    -> 1 int32 output with int8 weights
+
+  file layout (little endian): NNUEFileHeader, then
+    int16 ft_weights[nnue_buckets * nnue_features][nnue_hidden]
+    int16 ft_biases[nnue_hidden]
+    int8  out_weights[2 * nnue_hidden]
+    int32 out_bias
+*/
+
+constexpr int nnue_buckets = 4;
+constexpr int nnue_features = 768;
+constexpr int nnue_hidden = 256;
+
+constexpr int nnue_qa = 127;     // clipping value of the accumulator activations
+constexpr int nnue_qb = 64;      // scale of the output weights
+constexpr int nnue_scale = 400;  // output to centipawns
+
+constexpr uint32_t nnue_version = 1;
+constexpr char nnue_default_file[] = "tce.nnue";
+
+// king buckets, indexed by the king square relative to the perspective (own back rank at the bottom)
+constexpr int king_buckets[SQUARE_NB] = {
+  3, 3, 3, 3, 3, 3, 3, 3,
+  3, 3, 3, 3, 3, 3, 3, 3,
+  3, 3, 3, 3, 3, 3, 3, 3,
+  3, 3, 3, 3, 3, 3, 3, 3,
+  3, 3, 3, 3, 3, 3, 3, 3,
+  3, 3, 3, 3, 3, 3, 3, 3,
+  2, 2, 2, 2, 2, 2, 2, 2,
+  0, 0, 0, 0, 1, 1, 1, 1,
+};
+
+struct NNUEFileHeader {
+  char magic[8];  // "TCENNUE"
+  uint32_t version;
+  uint32_t buckets;
+  uint32_t features;
+  uint32_t hidden;
+};
+
+struct NNUEWeights {
+  alignas(64) int16_t ft_weights[nnue_buckets * nnue_features][nnue_hidden];
+  alignas(64) int16_t ft_biases[nnue_hidden];
+  alignas(64) int8_t out_weights[2 * nnue_hidden];
+  int32_t out_bias;
+};
+
+struct Accumulator {
+  alignas(64) int16_t values[COLOR_NB][nnue_hidden];
+};
+
+// accumulator of the last position seen with a king bucket, refreshed from the piece differences
+struct RefreshEntry {
+  alignas(64) int16_t values[nnue_hidden];
+  Bitboard bitboards[PIECE_NB];
+};
+
+// accumulators of a search thread, one per ply, updated by make_move and unmake_move
+class NNUEState {
+public:
+  void reset(Position* pos);
+  void push(Position* pos, Move move, Piece captured);
+  void pop() { current--; }
+  Score evaluate(Position* pos) const;
+
+private:
+  void refresh(Position* pos, Color perspective);
+
+  Accumulator stack[MAX_PLY_SEARCH + 2];
+  int current = 0;
+  RefreshEntry refresh_cache[COLOR_NB][nnue_buckets];
+};
+
+extern bool nnue_loaded;
+extern bool nnue_enabled;
+extern U64 nnue_checksum;  // of the loaded weights
+
+bool nnue_load(const std::string& path);
+bool nnue_active();
+const char* nnue_simd_name();
+U64 eval_id();
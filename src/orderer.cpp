@@ -1,53 +1,170 @@
 #include "orderer.hpp"
 
 #include "search.hpp"
+#include "see.hpp"
 
 Orderer::Orderer(Position* p, KillerMoves* km, HistoryMoves* hm, Move p_best_move) : pos(p), killer_moves(km), history_moves(hm), previous_best_move(p_best_move) {
-  generate_moves(pos, &move_list);  
-  score_moves();
+  stage = Orderer_Stage::TT_MOVE;
   current_idx = 0;
+  bad_idx = 0;
+  end_bad = 0;
 }
 
-void Orderer::score_moves() {
+inline Piece captured_piece(Position* pos, Move move) {
+  if (get_move_enpassant_f(move)) return (pos->side == Color::WHITE) ? Piece::BP : Piece::WP;
+  return pos->board[get_move_target(move)];
+}
+
+inline int capture_score(Position* pos, Move move) {
+  // MVV-LVA, with queen promotions first
+  Piece target_piece = captured_piece(pos, move);
+  Piece promoted = get_move_promoted(move);
+
+  int score = (target_piece != Piece::NO_PIECE) ? mvv_lva[get_move_piece(move)][target_piece] : 0;
+  if (promoted == Piece::WQ || promoted == Piece::BQ) score += QUEEN_PROMOTION_SORT;
+  return score;
+}
+
+void Orderer::score_captures() {
+  // losing captures and underpromotions are sent to the end
   MoveExt* moveExt;
   for (int count = 0; count < move_list.move_count; count++) {
     moveExt = &move_list.moves[count];
-    if (moveExt->move ==  previous_best_move) {
-      moveExt->score = BEST_SCORE_SORT;
+    Piece piece = get_move_piece(moveExt->move);
+    Piece promoted = get_move_promoted(moveExt->move);
+    Piece target_piece = captured_piece(pos, moveExt->move);
+
+    moveExt->score = capture_score(pos, moveExt->move);
+
+    if (promoted) {
+      if (promoted != Piece::WQ && promoted != Piece::BQ) moveExt->score += BAD_CAPTURE_SORT;
     }
-    else if (get_move_capture_f(moveExt->move)) {
-      Piece target_piece = Piece::WP;
+    else if (see_values[piece] > see_values[target_piece] && !see_ge(pos, moveExt->move, 0))
+      moveExt->score += BAD_CAPTURE_SORT;
+  }
+}
+
+void Orderer::score_quiets() {
+  MoveExt* moveExt;
+  for (int count = current_idx; count < move_list.move_count; count++) {
+    moveExt = &move_list.moves[count];
+    moveExt->score = (*history_moves)[get_move_piece(moveExt->move)][get_move_target(moveExt->move)];
+  }
+}
+
+Move Orderer::pick_best(int& idx, int end_idx) {
+  // selection sort step, the best move of [idx, end_idx) is swapped to idx and idx is advanced
+  int highest_idx = idx;
+
+  for (int i = idx + 1; i < end_idx; i++) {
+    if (move_list.moves[i].score > move_list.moves[highest_idx].score)
+      highest_idx = i;
+  }
+
+  MoveExt temp = move_list.moves[idx];
+  move_list.moves[idx] = move_list.moves[highest_idx];
+  move_list.moves[highest_idx] = temp;
+
+  return move_list.moves[idx++].move;
+}
+
+inline bool is_quiet(Move move) {
+  // moves of the quiet generator, the killer stage must not repeat a capture or a promotion
+  return !get_move_capture_f(move) && !get_move_enpassant_f(move) && !get_move_promoted(move);
+}
+
+bool Orderer::is_killer(Move move) const {
+  return move == (*killer_moves)[0][pos->ply] || move == (*killer_moves)[1][pos->ply];
+}
+
+Move Orderer::next_move() {
+  Move move;
+
+  switch (stage) {
+    case Orderer_Stage::TT_MOVE:
+      stage = Orderer_Stage::INIT_CAPTURES;
+      if (is_pseudo_legal(pos, previous_best_move) && is_legal(pos, previous_best_move))
+        return previous_best_move;
+      [[fallthrough]];
 
-      Piece start_piece = (pos->side == Color::WHITE) ? Piece::BP : Piece::WP;
-      Piece end_piece = (pos->side == Color::WHITE) ? Piece::BK : Piece::WK;
+    case Orderer_Stage::INIT_CAPTURES:
+      generate_moves<Gen_Type::CAPTURES>(pos, &move_list);
+      score_captures();
+      stage = Orderer_Stage::GOOD_CAPTURES;
+      [[fallthrough]];
 
-      for (Piece piece = start_piece; piece <= end_piece; ++piece) {
-        if (get_bit(pos->bitboards[piece], get_move_target(moveExt->move))) {
-          target_piece = piece;
+    case Orderer_Stage::GOOD_CAPTURES:
+      while (current_idx < move_list.move_count) {
+        move = pick_best(current_idx, move_list.move_count);
+        if (move_list.moves[current_idx - 1].score < 0) {
+          current_idx--;
           break;
         }
+        if (move != previous_best_move) return move;
       }
+      bad_idx = current_idx;
+      end_bad = move_list.move_count;
+      stage = Orderer_Stage::FIRST_KILLER;
+      [[fallthrough]];
 
-      moveExt->score =  mvv_lva[get_move_piece(moveExt->move)][target_piece] + CAP_SCORE_SORT;
-    }
-    else {
-      if ((*killer_moves)[0][pos->ply] == moveExt->move) {
-        moveExt->score = FIRST_KILLER_SORT;
-      }
-      else if ((*killer_moves)[1][pos->ply] == moveExt->move) {
-        moveExt->score = SECOND_KILLER_SORT;
+    case Orderer_Stage::FIRST_KILLER:
+      stage = Orderer_Stage::SECOND_KILLER;
+      move = (*killer_moves)[0][pos->ply];
+      if (move != previous_best_move && is_quiet(move) && is_pseudo_legal(pos, move) && is_legal(pos, move))
+        return move;
+      [[fallthrough]];
+
+    case Orderer_Stage::SECOND_KILLER:
+      stage = Orderer_Stage::INIT_QUIETS;
+      move = (*killer_moves)[1][pos->ply];
+      if (move != previous_best_move && move != (*killer_moves)[0][pos->ply] && is_quiet(move) && is_pseudo_legal(pos, move) && is_legal(pos, move))
+        return move;
+      [[fallthrough]];
+
+    case Orderer_Stage::INIT_QUIETS:
+      // the quiets are appended after the captures
+      current_idx = end_bad;
+      generate_moves<Gen_Type::QUIETS>(pos, &move_list);
+      score_quiets();
+      stage = Orderer_Stage::QUIET_MOVES;
+      [[fallthrough]];
+
+    case Orderer_Stage::QUIET_MOVES:
+      while (current_idx < move_list.move_count) {
+        move = pick_best(current_idx, move_list.move_count);
+        if (move != previous_best_move && !is_killer(move)) return move;
       }
-      else {
-        moveExt->score = (*history_moves)[get_move_piece(moveExt->move)][get_move_target(moveExt->move)];
+      stage = Orderer_Stage::BAD_CAPTURES;
+      [[fallthrough]];
+
+    case Orderer_Stage::BAD_CAPTURES:
+      while (bad_idx < end_bad) {
+        move = pick_best(bad_idx, end_bad);
+        if (move != previous_best_move) return move;
       }
-    }
+      stage = Orderer_Stage::DONE;
+      [[fallthrough]];
+
+    case Orderer_Stage::DONE:
+      break;
   }
+
+  return UNDEFINED_MOVE;
 }
 
-Move Orderer::next_move() {
-  if (current_idx >= move_list.move_count) {
-    return UNDEFINED_MOVE;
+QuiescenceOrderer::QuiescenceOrderer(Position* pos, Move previous_best_move) {
+  generate_captures(pos, &move_list);
+
+  for (int count = 0; count < move_list.move_count; count++) {
+    MoveExt* moveExt = &move_list.moves[count];
+    moveExt->score = (moveExt->move == previous_best_move) ? TT_MOVE_SORT : capture_score(pos, moveExt->move);
   }
+  current_idx = 0;
+}
+
+Move QuiescenceOrderer::next_move() {
+  if (current_idx >= move_list.move_count)
+    return UNDEFINED_MOVE;
 
   int highest_idx = current_idx;
 
@@ -61,4 +178,4 @@ Move Orderer::next_move() {
   move_list.moves[highest_idx] = temp;
 
   return move_list.moves[current_idx++].move;
-}
\ No newline at end of file
+}
@@ -4,18 +4,26 @@
 #include "move.hpp"
 #include "definition.hpp"
 
-constexpr int BEST_SCORE_SORT     = 1000000;
-constexpr int CAP_SCORE_SORT      = 100000;
-constexpr int FIRST_KILLER_SORT   = 5000;
-constexpr int SECOND_KILLER_SORT  = 3000;
+// stages of the move picker, moves are generated lazily so that a cutoff skips the later stages
+enum Orderer_Stage {
+  TT_MOVE, INIT_CAPTURES, GOOD_CAPTURES, FIRST_KILLER, SECOND_KILLER, INIT_QUIETS, QUIET_MOVES, BAD_CAPTURES, DONE
+};
+
+constexpr int TT_MOVE_SORT         = 1000000;
+constexpr int QUEEN_PROMOTION_SORT = 600;
+constexpr int BAD_CAPTURE_SORT     = -100000;
 
 class Orderer {
 public:
   Orderer(Position* pos, KillerMoves* killer_moves, HistoryMoves* history_moves, Move previous_best_move);
-  void score_moves();
+  void score_captures();
+  void score_quiets();
   Move next_move();
 
+  Orderer_Stage stage;
   int current_idx;
+  int bad_idx;      // bad captures are kept in [bad_idx, end_bad) while the quiets are searched
+  int end_bad;
   MoveList move_list;
 
   Position* pos;
@@ -23,6 +31,20 @@ public:
   KillerMoves* killer_moves;
   HistoryMoves* history_moves;
   Move previous_best_move;
+
+private:
+  Move pick_best(int& idx, int end_idx);
+  bool is_killer(Move move) const;
+};
+
+// move picker of the quiescence search, the hash move is only tried if it is a generated capture
+class QuiescenceOrderer {
+public:
+  QuiescenceOrderer(Position* pos, Move previous_best_move);
+  Move next_move();
+
+  int current_idx;
+  MoveList move_list;
 };
 
 /*                       
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "definition.hpp"
+#include "bitboard.hpp"
+
+// number of entries of each thread's pawn hash table, a power of two
+constexpr size_t pawn_table_size = 16384;
+
+// pawn structure evaluation, only depends on the pawns of both sides
+struct PawnEntry {
+  U64 key;
+  ScoreExt score;
+
+  Bitboard semi_open_files[COLOR_NB];  // files without pawn of the color
+};
+
+class PawnTable {
+public:
+  PawnEntry* probe(U64 pawn_key) { return &entries[pawn_key & (pawn_table_size - 1)]; }
+
+private:
+  PawnEntry entries[pawn_table_size]{};
+};
@@ -3,57 +3,308 @@
 #include "movegen.hpp"
 #include "timeman.hpp"
 
+#include <atomic>
+#include <charconv>  // std::from_chars
+#include <cstring>  // memset
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>  // std::pair
+#include <vector>
 
-void perft_driver(Position* pos, int depth, NodeCounter& nodes) {
-  // recursion escape condition
-  if (depth == 0) {
-    nodes++;
+PerftTable PerftTT;
+
+PerftTable::~PerftTable() {
+  large_page_free(table, entry_count * sizeof(PerftEntry), table_page_type);
+}
+
+void PerftTable::resize(size_t mb_size) {
+  large_page_free(table, entry_count * sizeof(PerftEntry), table_page_type);
+  table = nullptr;
+  entry_count = 0;
+  index_mask = 0;
+
+  if (mb_size == 0) return;
+
+  // round the number of entries down to a power of two
+  size_t new_count = 1;
+  while (2 * new_count * sizeof(PerftEntry) <= mb_size * 1024 * 1024)
+    new_count *= 2;
+
+  table = static_cast<PerftEntry*>(large_page_alloc(new_count * sizeof(PerftEntry), table_page_type));
+  if (!table) {
+    std::cout << "info string error: failed to allocate " << mb_size << "MB for the perft hash" << std::endl;
     return;
   }
-  else {
 
-    MoveList move_list[1];
-    generate_moves(pos, move_list);
+  entry_count = new_count;
+  index_mask = new_count - 1;
+  clear();
+}
 
-    for (int count = 0; count < move_list->move_count; count++) {
-      Position next_pos = Position(pos);
+void PerftTable::clear() {
+  memset(static_cast<void*>(table), 0, entry_count * sizeof(PerftEntry));
+}
 
-      if (!make_move(&next_pos, move_list->moves[count].move, Move_Type::ALL_MOVES))
-        continue;
+bool PerftTable::probe(U64 key, int depth, NodeCounter& nodes) const {
+  const PerftEntry& entry = table[key & index_mask];
+  U64 data = entry.data.load(std::memory_order_relaxed);
 
-       perft_driver(&next_pos, depth - 1, nodes);
-    }
+  if ((entry.key.load(std::memory_order_relaxed) ^ data) != key || int(data & 0xff) != depth)
+    return false;
+
+  nodes = data >> 8;
+  return true;
+}
+
+void PerftTable::store(U64 key, int depth, NodeCounter nodes) {
+  // always replace, deeper results are the most expensive but also the rarest
+  PerftEntry& entry = table[key & index_mask];
+  U64 data = (nodes << 8) | U64(depth);
+
+  entry.key.store(key ^ data, std::memory_order_relaxed);
+  entry.data.store(data, std::memory_order_relaxed);
+}
+
+NodeCounter perft(Position* pos, int depth) {
+  if (depth == 0) return 1;
+
+  MoveList move_list[1];
+  generate_moves(pos, move_list);
+
+  // bulk counting, the generator only returns legal moves
+  if (depth == 1) return move_list->move_count;
+
+  NodeCounter nodes = 0;
+  if (PerftTT.enabled() && PerftTT.probe(pos->hash_key, depth, nodes))
+    return nodes;
+
+  UndoInfo undo;
+
+  for (int count = 0; count < move_list->move_count; count++) {
+    make_move(pos, move_list->moves[count].move, undo);
+    nodes += perft(pos, depth - 1);
+    unmake_move(pos, move_list->moves[count].move, undo);
   }
+
+  if (PerftTT.enabled())
+    PerftTT.store(pos->hash_key, depth, nodes);
+
+  return nodes;
 }
 
-void perft_test(Position* pos, int depth) {
-  std::cout << "\n\n Performance test\n\n";
+// a work item of the parallel perft, a root move and a reply when the tree is split one ply deeper
+struct PerftSplit {
+  int root_idx;
+  Move root_move;
+  Move reply;
+  NodeCounter nodes;
+};
 
+inline void perft_worker(Position pos, int depth, std::vector<PerftSplit>& splits, std::atomic<size_t>& next_split) {
+  // each worker owns a copy of the position, the perft hash is shared
+  UndoInfo root_undo, reply_undo;
+  size_t idx;
+
+  while ((idx = next_split.fetch_add(1, std::memory_order_relaxed)) < splits.size()) {
+    PerftSplit& split = splits[idx];
+
+    make_move(&pos, split.root_move, root_undo);
+    if (split.reply != UNDEFINED_MOVE) {
+      make_move(&pos, split.reply, reply_undo);
+      split.nodes = perft(&pos, depth - 2);
+      unmake_move(&pos, split.reply, reply_undo);
+    }
+    else
+      split.nodes = perft(&pos, depth - 1);
+    unmake_move(&pos, split.root_move, root_undo);
+  }
+}
+
+void perft_test(Position* pos, int depth, int thread_count) {
+  // divide: the node count below each root move, then the total
   TimePoint start = get_time_ms();
-  NodeCounter nodes = 0;
 
   MoveList move_list[1];
   generate_moves(pos, move_list);
 
+  // with several threads and enough depth, the tree is split after the replies for a better balance
+  std::vector<PerftSplit> splits;
+  UndoInfo undo;
+
   for (int count = 0; count < move_list->move_count; count++) {
-    Position next_pos = Position(pos);
+    Move move = move_list->moves[count].move;
 
-    if (!make_move(&next_pos, move_list->moves[count].move, Move_Type::ALL_MOVES))
+    if (thread_count == 1 || depth < 3) {
+      splits.push_back({ count, move, UNDEFINED_MOVE, 0 });
       continue;
+    }
+
+    MoveList replies[1];
+    make_move(pos, move, undo);
+    generate_moves(pos, replies);
+    unmake_move(pos, move, undo);
+
+    for (int reply = 0; reply < replies->move_count; reply++)
+      splits.push_back({ count, move, replies->moves[reply].move, 0 });
+
+    // a mate or a stalemate after the root move has no nodes below, it is kept for the divide output
+    if (replies->move_count == 0)
+      splits.push_back({ count, move, UNDEFINED_MOVE, 0 });
+  }
+
+  std::atomic<size_t> next_split = 0;
+  std::vector<std::thread> workers;
+
+  for (int idx = 1; idx < thread_count; idx++)
+    workers.emplace_back(perft_worker, *pos, depth, std::ref(splits), std::ref(next_split));
+  perft_worker(*pos, depth, splits, next_split);
+
+  for (std::thread& worker : workers)
+    worker.join();
+
+  // sum the splits of each root move, they are stored in root move order
+  NodeCounter nodes = 0;
+  size_t idx = 0;
+
+  for (int count = 0; count < move_list->move_count; count++) {
+    NodeCounter move_nodes = 0;
+    for (; idx < splits.size() && splits[idx].root_idx == count; idx++)
+      move_nodes += splits[idx].nodes;
+
+    nodes += move_nodes;
+    print_move(move_list->moves[count].move);
+    std::cout << ": " << move_nodes << '\n';
+  }
+
+  TimePoint elapsed = get_time_ms() - start;
+
+  std::cout << "\nNodes searched: " << nodes << '\n';
+  std::cout << "Time: " << elapsed << "ms\n";
+  std::cout << "NPS: " << 1000 * nodes / (elapsed + 1) << '\n' << std::endl;
+}
+
+// an EPD line of a perft suite, the expected node counts by depth
+struct PerftSuiteEntry {
+  std::string fen;
+  std::vector<std::pair<int, NodeCounter>> expected;
+  NodeCounter nodes;
+  int failed_depth;
+  NodeCounter failed_nodes;
+};
+
+template<typename T>
+inline bool parse_number(const std::string& token, T& value) {
+  // the whole token must be a number
+  auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+  return error == std::errc() && end == token.data() + token.size();
+}
+
+inline bool parse_perft_suite(const std::string& path, std::vector<PerftSuiteEntry>& entries) {
+  // lines are formatted as "<fen> ;D1 <nodes> ;D2 <nodes> ..."
+  std::ifstream file(path);
+  if (!file) return false;
+
+  std::string line;
+  while (std::getline(file, line)) {
+    size_t separator = line.find(';');
+    if (separator == std::string::npos) continue;
+
+    std::string fen = line.substr(0, separator);
+    fen.erase(fen.find_last_not_of(" \t") + 1);
 
-    NodeCounter cummulative_nodes = nodes;
+    PerftSuiteEntry entry = { fen, {}, 0, 0, 0 };
 
-    perft_driver(&next_pos, depth - 1, nodes);
+    std::istringstream ss(line.substr(separator));
+    std::string token, nodes_token;
 
-    NodeCounter old_nodes = nodes - cummulative_nodes;
-    std::cout << "    move: " << square_to_coordinates[get_move_source(move_list->moves[count].move)]
-      << square_to_coordinates[get_move_target(move_list->moves[count].move)]
-      << ((get_move_promoted(move_list->moves[count].move)) ? ascii_pieces[get_move_promoted(move_list->moves[count].move)] : ' ')
-      << "  nodes : " << old_nodes << std::endl;
+    // malformed fields are skipped
+    while (ss >> token) {
+      if (token.size() <= 2 || token[0] != ';' || token[1] != 'D' || !(ss >> nodes_token)) continue;
+
+      int depth;
+      NodeCounter expected_nodes;
+      if (parse_number(token.substr(2), depth) && parse_number(nodes_token, expected_nodes))
+        entry.expected.emplace_back(depth, expected_nodes);
+    }
+
+    if (!entry.expected.empty())
+      entries.push_back(entry);
   }
 
-  std::cout << "\n    Depth: " << depth << std::endl;
-  std::cout << "    Nodes: " << nodes << std::endl;
-  std::cout << "    Time: " << get_time_ms() - start << "ms\n" << std::endl;
-}
\ No newline at end of file
+  return true;
+}
+
+inline void perft_suite_worker(std::vector<PerftSuiteEntry>& entries, int max_depth, std::atomic<size_t>& next_entry) {
+  // one position per worker at a time, its depths are checked in order until the first failure
+  Position pos;
+  size_t idx;
+
+  while ((idx = next_entry.fetch_add(1, std::memory_order_relaxed)) < entries.size()) {
+    PerftSuiteEntry& entry = entries[idx];
+    pos.set(entry.fen);
+
+    for (const auto& [depth, expected_nodes] : entry.expected) {
+      if (depth < 1 || depth > max_depth) continue;
+
+      NodeCounter nodes = perft(&pos, depth);
+      entry.nodes += nodes;
+
+      if (nodes != expected_nodes) {
+        entry.failed_depth = depth;
+        entry.failed_nodes = nodes;
+        break;
+      }
+    }
+  }
+}
+
+void perft_suite(const std::string& path, int max_depth, int thread_count) {
+  std::vector<PerftSuiteEntry> entries;
+
+  if (!parse_perft_suite(path, entries)) {
+    std::cout << "info string error: could not read " << path << std::endl;
+    return;
+  }
+
+  TimePoint start = get_time_ms();
+
+  std::atomic<size_t> next_entry = 0;
+  std::vector<std::thread> workers;
+
+  for (int idx = 1; idx < thread_count; idx++)
+    workers.emplace_back(perft_suite_worker, std::ref(entries), max_depth, std::ref(next_entry));
+  perft_suite_worker(entries, max_depth, next_entry);
+
+  for (std::thread& worker : workers)
+    worker.join();
+
+  TimePoint elapsed = get_time_ms() - start;
+
+  NodeCounter nodes = 0;
+  int passed = 0;
+
+  for (size_t idx = 0; idx < entries.size(); idx++) {
+    const PerftSuiteEntry& entry = entries[idx];
+    nodes += entry.nodes;
+
+    if (!entry.failed_depth) {
+      passed++;
+      continue;
+    }
+
+    NodeCounter expected_nodes = 0;
+    for (const auto& [depth, expected] : entry.expected)
+      if (depth == entry.failed_depth) expected_nodes = expected;
+
+    std::cout << "FAIL " << idx + 1 << ": " << entry.fen << " depth " << entry.failed_depth
+              << ": " << entry.failed_nodes << " nodes, expected " << expected_nodes << '\n';
+  }
+
+  std::cout << "\nPassed: " << passed << '/' << entries.size() << '\n';
+  std::cout << "Nodes searched: " << nodes << '\n';
+  std::cout << "Time: " << elapsed << "ms\n";
+  std::cout << "NPS: " << 1000 * nodes / (elapsed + 1) << '\n' << std::endl;
+}
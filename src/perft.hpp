@@ -1,6 +1,49 @@
 #pragma once
 
+#include "definition.hpp"
 #include "position.hpp"
+#include "memory.hpp"
 
-void perft_driver(Position* pos, int depth, NodeCounter& nodes);
-void perft_test(Position* pos, int depth);
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+// perft hash size in MB, the table is disabled by default
+constexpr int default_perft_hash_size = 0;
+constexpr int max_perft_hash_size = 4096;
+
+/* perft hash entry, the node count of a position searched to a given depth
+
+  data         node count (56 upper bits) and depth (8 lower bits)
+  key          hash key ^ data, an entry torn by two writers fails the key check
+*/
+struct PerftEntry {
+  std::atomic<U64> key;
+  std::atomic<U64> data;
+};
+
+static_assert(std::atomic<U64>::is_always_lock_free, "perft entries must be lock-free");
+
+class PerftTable {
+public:
+  ~PerftTable();
+
+  bool probe(U64 key, int depth, NodeCounter& nodes) const;
+  void store(U64 key, int depth, NodeCounter nodes);
+  void resize(size_t mb_size);
+  void clear();
+
+  bool enabled() const { return entry_count != 0; }
+
+private:
+  PerftEntry* table = nullptr;
+  size_t entry_count = 0;
+  Page_Type table_page_type = Page_Type::NORMAL_PAGES;
+  U64 index_mask = 0;
+};
+
+extern PerftTable PerftTT;
+
+NodeCounter perft(Position* pos, int depth);
+void perft_test(Position* pos, int depth, int thread_count);
+void perft_suite(const std::string& path, int max_depth, int thread_count);
@@ -2,32 +2,22 @@
 
 #include "rng.hpp"
 #include "move.hpp"
+#include "ttable.hpp"
+#include "evaluate.hpp"
+#include "nnue.hpp"
 
 #include <sstream>
+#include <cstdlib>    // abs
 #include <cstring>    // memcpy memset
 #include <iostream>
 
 U64 piece_keys[12][64];
 U64 side_key;
+U64 no_pawns_key;
+U64 material_keys[PIECE_NB][max_piece_count];
 U64 enpassant_keys[64];
 U64 castle_keys[64];
 
-Position::Position(Position* pos) {
-  memcpy(bitboards, pos->bitboards, sizeof(bitboards));
-  memcpy(occupancies, pos->occupancies, sizeof(occupancies));
-  memcpy(repetition_table, pos->repetition_table, sizeof(repetition_table));
-  memcpy(piece_count, pos->piece_count, sizeof(piece_count));
-  
-  side = pos->side;
-  enpassant = pos->enpassant;
-  castle_rights = pos->castle_rights;
-
-  hash_key = pos->hash_key;
-  repetition_index = pos->repetition_index;
-  ply = pos->ply;
-
-};
-
 void Position::set(const std::string& fenStr) {
   memset(this, 0, sizeof(Position));
 
@@ -38,6 +28,9 @@ void Position::set(const std::string& fenStr) {
   Square square = Square::FIRST_SQUARE;
   Piece piece;
 
+  for (Square sq = Square::FIRST_SQUARE; sq <= Square::LAST_SQUARE; ++sq)
+    board[sq] = Piece::NO_PIECE;
+
   // parse piece placement
   while ((ss >> token) && token != ' ') {
     if (token == '/')         continue;
@@ -45,6 +38,7 @@ void Position::set(const std::string& fenStr) {
     else {
       piece = char_pieces.at(token);
       set_bit(bitboards[piece], square);
+      board[square] = piece;
       ++square;
     }
   }
@@ -90,19 +84,13 @@ void Position::set(const std::string& fenStr) {
     piece_count[piece] = count_bits(bitboards[piece]);
   // ================================================
 
-  hash_key = generate_hash_key(this);
-
-  repetition_index = 0;
-  repetition_table[repetition_index] = hash_key;
-}
+  ss >> std::skipws >> halfmove_clock;
 
-bool Position::is_repetition() {
-  if (!ply) return false;
-  for (int index = 0; index < repetition_index; index++) {
-    if (repetition_table[index] == hash_key)
-      return true;
-  }
-  return false;
+  hash_key = generate_hash_key(this);
+  pawn_key = generate_pawn_key(this);
+  material_key = generate_material_key(this);
+  psqt = compute_psqt(this, phase);
+  set_check_info(this);
 }
 
 U64 generate_hash_key(Position* pos) {
@@ -133,8 +121,37 @@ U64 generate_hash_key(Position* pos) {
   return final_key;
 };
 
+U64 generate_pawn_key(Position* pos) {
+  U64 final_key = no_pawns_key;
+
+  for (Piece piece : { Piece::WP, Piece::BP }) {
+    Bitboard bitboard = pos->bitboards[piece];
+    while (bitboard) {
+      Square square = get_lsb_index(bitboard);
+
+      final_key ^= piece_keys[piece][square];
+
+      pop_bit(bitboard, square);
+    }
+  }
+
+  return final_key;
+}
+
+U64 generate_material_key(Position* pos) {
+  U64 final_key = 0ULL;
+
+  // one key per piece of each type, so that the key only depends on the piece counts
+  for (Piece piece = Piece::WP; piece <= Piece::BK; ++piece) {
+    for (int count = 0; count < pos->piece_count[piece]; count++)
+      final_key ^= material_keys[piece][count];
+  }
+
+  return final_key;
+}
+
 void init_random_keys() {
-  RNG rng((unsigned long)1804289383);
+  RNG rng(zobrist_seed);
 
   // loop over pieces and squares
   for (Piece piece = Piece::WP; piece <= Piece::BK; ++piece) {
@@ -155,6 +172,15 @@ void init_random_keys() {
       
   // init random side key
   side_key = rng.rand64();
+
+  // init the key of the pawn structure without pawns, the pawn keys start from it
+  no_pawns_key = rng.rand64();
+
+  // init material keys
+  for (Piece piece = Piece::WP; piece <= Piece::BK; ++piece) {
+    for (int count = 0; count < max_piece_count; count++)
+      material_keys[piece][count] = rng.rand64();
+  }
 }
 
 bool is_square_attacked(Position* pos, Square square, Color side) {
@@ -185,174 +211,329 @@ bool is_square_attacked(Position* pos, Square square, Color side) {
 }
 
 
-bool make_move(Position* pos, Move move, Move_Type move_flag) {
-  // return false if the move is illegal, true otherwise
-  if (move_flag == Move_Type::ALL_MOVES) {
-    // parse move
-    Square source_square = get_move_source(move);
-    Square target_square = get_move_target(move);
-    Piece piece = get_move_piece(move);
-    Piece promoted = get_move_promoted(move);
-    int capture_f = get_move_capture_f(move);
-    int double_f = get_move_double_f(move);
-    int enpassant_f = get_move_enpassant_f(move);
-    int castling_f = get_move_castling_f(move);
-
-    // move piece
-    pop_bit(pos->bitboards[piece], source_square);
-    set_bit(pos->bitboards[piece], target_square);
-    pos->hash_key ^= piece_keys[piece][source_square];
-    pos->hash_key ^= piece_keys[piece][target_square];
-    pop_bit(pos->occupancies[pos->side], source_square);
-    pop_bit(pos->occupancies[Color::BOTH], source_square);
-    set_bit(pos->occupancies[pos->side], target_square);
-    set_bit(pos->occupancies[Color::BOTH], target_square);
-
-    // handle capture
-    if (capture_f) {
-      Piece start_piece = (pos->side == Color::WHITE) ? Piece::BP : Piece::WP;
-      Piece end_piece = (pos->side == Color::WHITE) ? Piece::BK : Piece::WK;
-
-      for (Piece bb_piece = start_piece; bb_piece <= end_piece; ++bb_piece) {
-        if (get_bit(pos->bitboards[bb_piece], target_square)) {
-          pop_bit(pos->bitboards[bb_piece], target_square);
-          pos->hash_key ^= piece_keys[bb_piece][target_square];
-          pos->piece_count[bb_piece]--;
-          break;
-        }
-      }
-      pop_bit(pos->occupancies[~pos->side], target_square);
-    }
+Bitboard attackers_to(Position* pos, Square square, Bitboard occupancy) {
+  // pieces of both sides attacking the square, sliders seen through the given occupancy
+  return (get_pawn_attacks(square, Color::BLACK) & pos->bitboards[Piece::WP])
+       | (get_pawn_attacks(square, Color::WHITE) & pos->bitboards[Piece::BP])
+       | (get_knight_attacks(square) & (pos->bitboards[Piece::WN] | pos->bitboards[Piece::BN]))
+       | (get_king_attacks(square) & (pos->bitboards[Piece::WK] | pos->bitboards[Piece::BK]))
+       | (get_bishop_attacks(square, occupancy) & (pos->bitboards[Piece::WB] | pos->bitboards[Piece::BB] | pos->bitboards[Piece::WQ] | pos->bitboards[Piece::BQ]))
+       | (get_rook_attacks(square, occupancy) & (pos->bitboards[Piece::WR] | pos->bitboards[Piece::BR] | pos->bitboards[Piece::WQ] | pos->bitboards[Piece::BQ]));
+}
 
-    // handle pawn promotion
-    if (promoted) {
-      set_bit(pos->bitboards[promoted], target_square);
-      pop_bit(pos->bitboards[piece], target_square);
-      pos->hash_key ^= piece_keys[promoted][target_square];
-      pos->hash_key ^= piece_keys[piece][target_square];
-      pos->piece_count[piece]--;
-      pos->piece_count[promoted]++;
-    }
+void set_check_info(Position* pos) {
+  // checkers and pinned pieces of the side to move, computed once per node for the legal generator
+  Color them = ~pos->side;
+  const Bitboard* enemy = &pos->bitboards[(them == Color::WHITE) ? Piece::WP : Piece::BP];  // pawn to king of the enemy
+  Square king_square = get_lsb_index(pos->bitboards[(pos->side == Color::WHITE) ? Piece::WK : Piece::BK]);
 
-    // handle en passant
-    if (enpassant_f) {
-      if (pos->side == Color::WHITE) {
-        pop_bit(pos->bitboards[Piece::BP], shift<Direction::DOWN>(target_square));
-        pos->hash_key ^= piece_keys[Piece::BP][shift<Direction::DOWN>(target_square)];
-        pop_bit(pos->occupancies[Color::BLACK], shift<Direction::DOWN>(target_square));
-        pop_bit(pos->occupancies[Color::BOTH], shift<Direction::DOWN>(target_square));
-        pos->piece_count[Piece::BP]--;
-      }
-      else {
-        pop_bit(pos->bitboards[Piece::WP], shift<Direction::UP>(target_square));
-        pos->hash_key ^= piece_keys[Piece::WP][shift<Direction::UP>(target_square)];
-        pop_bit(pos->occupancies[Color::WHITE], shift<Direction::UP>(target_square));
-        pop_bit(pos->occupancies[Color::BOTH], shift<Direction::UP>(target_square));
-        pos->piece_count[Piece::WP]--;
-      }
-    }
+  pos->checkers = (get_pawn_attacks(king_square, pos->side) & enemy[0]) | (get_knight_attacks(king_square) & enemy[1]);
+  pos->pinned = 0ULL;
 
-    // reset enpassant square
-    if (pos->enpassant != Square::NO_SQUARE) {
-      pos->hash_key ^= enpassant_keys[pos->enpassant];
-      pos->enpassant = Square::NO_SQUARE;
-    }
+  // enemy sliders aligned with the king, checking if nothing stands between, pinning a single own piece
+  Bitboard snipers = (get_bishop_attacks(king_square, pos->occupancies[them]) & (enemy[2] | enemy[4]))
+                   | (get_rook_attacks(king_square, pos->occupancies[them]) & (enemy[3] | enemy[4]));
 
-    // handle double pawn move
-    if (double_f) {
-      if (pos->side == Color::WHITE) {
-        pos->enpassant = shift<Direction::DOWN>(target_square);
-      }
-      else {
-        pos->enpassant = shift<Direction::UP>(target_square);
-      }
-      pos->hash_key ^= enpassant_keys[pos->enpassant];
-    }
+  while (snipers) {
+    Square sniper_square = get_lsb_index(snipers);
+    Bitboard blockers = get_between_bb(king_square, sniper_square) & pos->occupancies[Color::BOTH];
 
-    // handle castle
-    if (castling_f) {
-      // move rook
-      switch (target_square)
-      {
-        case Square::G1:
-          set_bit(pos->bitboards[Piece::WR], Square::F1);
-          pop_bit(pos->bitboards[Piece::WR], Square::H1);
-          pos->hash_key ^= piece_keys[Piece::WR][Square::F1];
-          pos->hash_key ^= piece_keys[Piece::WR][Square::H1];
-          set_bit(pos->occupancies[Color::WHITE], Square::F1);
-          pop_bit(pos->occupancies[Color::WHITE], Square::H1);
-          set_bit(pos->occupancies[Color::BOTH], Square::F1);
-          pop_bit(pos->occupancies[Color::BOTH], Square::H1);
-          break;
-        case Square::C1:
-          set_bit(pos->bitboards[Piece::WR], Square::D1);
-          pop_bit(pos->bitboards[Piece::WR], Square::A1);
-          pos->hash_key ^= piece_keys[Piece::WR][Square::D1];
-          pos->hash_key ^= piece_keys[Piece::WR][Square::A1];
-          set_bit(pos->occupancies[Color::WHITE], Square::D1);
-          pop_bit(pos->occupancies[Color::WHITE], Square::A1);
-          set_bit(pos->occupancies[Color::BOTH], Square::D1);
-          pop_bit(pos->occupancies[Color::BOTH], Square::A1);
-          break;
-        case Square::G8:
-          set_bit(pos->bitboards[Piece::BR], Square::F8);
-          pop_bit(pos->bitboards[Piece::BR], Square::H8);
-          pos->hash_key ^= piece_keys[Piece::BR][Square::F8];
-          pos->hash_key ^= piece_keys[Piece::BR][Square::H8];
-          set_bit(pos->occupancies[Color::BLACK], Square::F8);
-          pop_bit(pos->occupancies[Color::BLACK], Square::H8);
-          set_bit(pos->occupancies[Color::BOTH], Square::F8);
-          pop_bit(pos->occupancies[Color::BOTH], Square::H8);
-          break;
-        case Square::C8:
-          set_bit(pos->bitboards[Piece::BR], Square::D8);
-          pop_bit(pos->bitboards[Piece::BR], Square::A8);
-          pos->hash_key ^= piece_keys[Piece::BR][Square::D8];
-          pos->hash_key ^= piece_keys[Piece::BR][Square::A8];
-          set_bit(pos->occupancies[Color::BLACK], Square::D8);
-          pop_bit(pos->occupancies[Color::BLACK], Square::A8);
-          set_bit(pos->occupancies[Color::BOTH], Square::D8);
-          pop_bit(pos->occupancies[Color::BOTH], Square::A8);
-          break;
-        default:
-          break;
-        }
-    }
+    if (!blockers)
+      pos->checkers |= 1ULL << sniper_square;
+    else if (!(blockers & (blockers - 1)) && (blockers & pos->occupancies[pos->side]))
+      pos->pinned |= blockers;
+    pop_bit(snipers, sniper_square);
+  }
+}
+
+void castling_rook(Square king_target, Piece& rook, Square& rook_source, Square& rook_target) {
+  // rook move of a castling, given the target square of the king
+  switch (king_target)
+  {
+    case Square::G1: rook = Piece::WR; rook_source = Square::H1; rook_target = Square::F1; break;
+    case Square::C1: rook = Piece::WR; rook_source = Square::A1; rook_target = Square::D1; break;
+    case Square::G8: rook = Piece::BR; rook_source = Square::H8; rook_target = Square::F8; break;
+    default:         rook = Piece::BR; rook_source = Square::A8; rook_target = Square::D8; break;
+  }
+}
 
-    // castling rights update
-    pos->hash_key ^= castle_keys[pos->castle_rights];
-    pos->castle_rights &= castling_rights[source_square];
-    pos->castle_rights &= castling_rights[target_square];
-    pos->hash_key ^= castle_keys[pos->castle_rights];
+inline void move_rook(Position* pos, Piece rook, Square source_square, Square target_square) {
+  Color color = (rook == Piece::WR) ? Color::WHITE : Color::BLACK;
+
+  pop_bit(pos->bitboards[rook], source_square);
+  set_bit(pos->bitboards[rook], target_square);
+  pop_bit(pos->occupancies[color], source_square);
+  set_bit(pos->occupancies[color], target_square);
+  pop_bit(pos->occupancies[Color::BOTH], source_square);
+  set_bit(pos->occupancies[Color::BOTH], target_square);
+  pos->board[source_square] = Piece::NO_PIECE;
+  pos->board[target_square] = rook;
+}
 
-    // change side
-    pos->side = ~pos->side;
-    pos->hash_key ^= side_key;
+void make_move(Position* pos, Move move, UndoInfo& undo) {
+  // the move must be legal, as produced by the generator or checked by is_legal
+  // parse move
+  Square source_square = get_move_source(move);
+  Square target_square = get_move_target(move);
+  Piece piece = get_move_piece(move);
+  Piece promoted = get_move_promoted(move);
+  int capture_f = get_move_capture_f(move);
+  int double_f = get_move_double_f(move);
+  int enpassant_f = get_move_enpassant_f(move);
+  int castling_f = get_move_castling_f(move);
+
+  // save the irreversible state
+  undo.captured = capture_f ? pos->board[target_square] : Piece::NO_PIECE;
+  undo.enpassant = pos->enpassant;
+  undo.castle_rights = pos->castle_rights;
+  undo.halfmove_clock = pos->halfmove_clock;
+  undo.plies_from_null = pos->plies_from_null;
+  undo.hash_key = pos->hash_key;
+  undo.pawn_key = pos->pawn_key;
+  undo.material_key = pos->material_key;
+  undo.psqt = pos->psqt;
+  undo.phase = pos->phase;
+  undo.checkers = pos->checkers;
+  undo.pinned = pos->pinned;
+
+  // update the fifty move rule clock
+  if (capture_f || enpassant_f || piece == Piece::WP || piece == Piece::BP)
+    pos->halfmove_clock = 0;
+  else
+    pos->halfmove_clock++;
+  pos->plies_from_null++;
+
+  // move piece
+  pop_bit(pos->bitboards[piece], source_square);
+  set_bit(pos->bitboards[piece], target_square);
+  pos->hash_key ^= piece_keys[piece][source_square];
+  pos->hash_key ^= piece_keys[piece][target_square];
+  pop_bit(pos->occupancies[pos->side], source_square);
+  pop_bit(pos->occupancies[Color::BOTH], source_square);
+  set_bit(pos->occupancies[pos->side], target_square);
+  set_bit(pos->occupancies[Color::BOTH], target_square);
+  pos->board[source_square] = Piece::NO_PIECE;
+  pos->board[target_square] = piece;
+  pos->psqt += psqt_values[piece][target_square] - psqt_values[piece][source_square];
+  if (piece == Piece::WP || piece == Piece::BP) {
+    pos->pawn_key ^= piece_keys[piece][source_square];
+    pos->pawn_key ^= piece_keys[piece][target_square];
+  }
 
-    ++pos->ply;
-    ++pos->repetition_index;
-    pos->repetition_table[pos->repetition_index] = pos->hash_key;
+  // handle capture
+  if (capture_f) {
+    pop_bit(pos->bitboards[undo.captured], target_square);
+    pos->hash_key ^= piece_keys[undo.captured][target_square];
+    pos->piece_count[undo.captured]--;
+    pos->material_key ^= material_keys[undo.captured][pos->piece_count[undo.captured]];
+    pos->psqt -= psqt_values[undo.captured][target_square];
+    pos->phase -= phase_values[undo.captured];
+    if (undo.captured == Piece::WP || undo.captured == Piece::BP)
+      pos->pawn_key ^= piece_keys[undo.captured][target_square];
+    pop_bit(pos->occupancies[~pos->side], target_square);
+  }
+
+  // handle pawn promotion
+  if (promoted) {
+    set_bit(pos->bitboards[promoted], target_square);
+    pop_bit(pos->bitboards[piece], target_square);
+    pos->board[target_square] = promoted;
+    pos->psqt += psqt_values[promoted][target_square] - psqt_values[piece][target_square];
+    pos->phase += phase_values[promoted];
+    pos->pawn_key ^= piece_keys[piece][target_square];
+    pos->hash_key ^= piece_keys[promoted][target_square];
+    pos->hash_key ^= piece_keys[piece][target_square];
+    pos->piece_count[piece]--;
+    pos->material_key ^= material_keys[piece][pos->piece_count[piece]];
+    pos->material_key ^= material_keys[promoted][pos->piece_count[promoted]];
+    pos->piece_count[promoted]++;
+  }
 
-    // make sure that king is not in check
-    if (is_square_attacked(pos, (pos->side == Color::WHITE) ? get_lsb_index(pos->bitboards[Piece::BK]) : get_lsb_index(pos->bitboards[Piece::WK]), pos->side)) {
-      return false;
+  // handle en passant
+  if (enpassant_f) {
+    if (pos->side == Color::WHITE) {
+      pop_bit(pos->bitboards[Piece::BP], shift<Direction::DOWN>(target_square));
+      pos->hash_key ^= piece_keys[Piece::BP][shift<Direction::DOWN>(target_square)];
+      pop_bit(pos->occupancies[Color::BLACK], shift<Direction::DOWN>(target_square));
+      pop_bit(pos->occupancies[Color::BOTH], shift<Direction::DOWN>(target_square));
+      pos->piece_count[Piece::BP]--;
+      pos->material_key ^= material_keys[Piece::BP][pos->piece_count[Piece::BP]];
+      pos->board[shift<Direction::DOWN>(target_square)] = Piece::NO_PIECE;
+      pos->psqt -= psqt_values[Piece::BP][shift<Direction::DOWN>(target_square)];
+      pos->pawn_key ^= piece_keys[Piece::BP][shift<Direction::DOWN>(target_square)];
+      undo.captured = Piece::BP;
     }
     else {
-      return true;
+      pop_bit(pos->bitboards[Piece::WP], shift<Direction::UP>(target_square));
+      pos->hash_key ^= piece_keys[Piece::WP][shift<Direction::UP>(target_square)];
+      pop_bit(pos->occupancies[Color::WHITE], shift<Direction::UP>(target_square));
+      pop_bit(pos->occupancies[Color::BOTH], shift<Direction::UP>(target_square));
+      pos->piece_count[Piece::WP]--;
+      pos->material_key ^= material_keys[Piece::WP][pos->piece_count[Piece::WP]];
+      pos->board[shift<Direction::UP>(target_square)] = Piece::NO_PIECE;
+      pos->psqt -= psqt_values[Piece::WP][shift<Direction::UP>(target_square)];
+      pos->pawn_key ^= piece_keys[Piece::WP][shift<Direction::UP>(target_square)];
+      undo.captured = Piece::WP;
     }
   }
-  else {
-    // check if the move is a capture
-    if (get_move_capture_f(move) || get_move_enpassant_f(move)) {
-      return make_move(pos, move, Move_Type::ALL_MOVES);
+
+  // reset enpassant square
+  if (pos->enpassant != Square::NO_SQUARE) {
+    pos->hash_key ^= enpassant_keys[pos->enpassant];
+    pos->enpassant = Square::NO_SQUARE;
+  }
+
+  // handle double pawn move
+  if (double_f) {
+    if (pos->side == Color::WHITE) {
+      pos->enpassant = shift<Direction::DOWN>(target_square);
     }
-    else
-      // don't make move
-      return false;
+    else {
+      pos->enpassant = shift<Direction::UP>(target_square);
+    }
+    pos->hash_key ^= enpassant_keys[pos->enpassant];
   }
+
+  // handle castle
+  if (castling_f) {
+    // move rook
+    Piece rook;
+    Square rook_source, rook_target;
+    castling_rook(target_square, rook, rook_source, rook_target);
+
+    move_rook(pos, rook, rook_source, rook_target);
+    pos->hash_key ^= piece_keys[rook][rook_source];
+    pos->hash_key ^= piece_keys[rook][rook_target];
+    pos->psqt += psqt_values[rook][rook_target] - psqt_values[rook][rook_source];
+  }
+
+  // castling rights update
+  pos->hash_key ^= castle_keys[pos->castle_rights];
+  pos->castle_rights &= castling_rights[source_square];
+  pos->castle_rights &= castling_rights[target_square];
+  pos->hash_key ^= castle_keys[pos->castle_rights];
+
+  // change side
+  pos->side = ~pos->side;
+  pos->hash_key ^= side_key;
+
+  // the key is final, load the TT bucket of the child while the move is searched
+  TT.prefetch(pos->hash_key);
+
+  ++pos->ply;
+
+  set_check_info(pos);
+  if (pos->nnue) pos->nnue->push(pos, move, undo.captured);
 }
 
-void make_null_move(Position* pos) {
+void unmake_move(Position* pos, Move move, const UndoInfo& undo) {
+  if (pos->nnue) pos->nnue->pop();
+
+  // parse move
+  Square source_square = get_move_source(move);
+  Square target_square = get_move_target(move);
+  Piece piece = get_move_piece(move);
+  Piece promoted = get_move_promoted(move);
+  int enpassant_f = get_move_enpassant_f(move);
+  int castling_f = get_move_castling_f(move);
+
+  --pos->ply;
+
+  // restore the irreversible state
+  pos->side = ~pos->side;
+  pos->enpassant = undo.enpassant;
+  pos->castle_rights = undo.castle_rights;
+  pos->halfmove_clock = undo.halfmove_clock;
+  pos->plies_from_null = undo.plies_from_null;
+  pos->hash_key = undo.hash_key;
+  pos->pawn_key = undo.pawn_key;
+  pos->material_key = undo.material_key;
+  pos->psqt = undo.psqt;
+  pos->phase = undo.phase;
+  pos->checkers = undo.checkers;
+  pos->pinned = undo.pinned;
+
+  // move piece back, turning a promoted piece into a pawn
+  if (promoted) {
+    pop_bit(pos->bitboards[promoted], target_square);
+    pos->piece_count[promoted]--;
+    pos->piece_count[piece]++;
+  }
+  else
+    pop_bit(pos->bitboards[piece], target_square);
+  set_bit(pos->bitboards[piece], source_square);
+  pop_bit(pos->occupancies[pos->side], target_square);
+  pop_bit(pos->occupancies[Color::BOTH], target_square);
+  set_bit(pos->occupancies[pos->side], source_square);
+  set_bit(pos->occupancies[Color::BOTH], source_square);
+  pos->board[target_square] = Piece::NO_PIECE;
+  pos->board[source_square] = piece;
+
+  // put back the captured piece
+  if (undo.captured != Piece::NO_PIECE) {
+    Square capture_square = target_square;
+    if (enpassant_f)
+      capture_square = (pos->side == Color::WHITE) ? shift<Direction::DOWN>(target_square) : shift<Direction::UP>(target_square);
+
+    set_bit(pos->bitboards[undo.captured], capture_square);
+    set_bit(pos->occupancies[~pos->side], capture_square);
+    set_bit(pos->occupancies[Color::BOTH], capture_square);
+    pos->piece_count[undo.captured]++;
+    pos->board[capture_square] = undo.captured;
+  }
+
+  // move rook back
+  if (castling_f) {
+    Piece rook;
+    Square rook_source, rook_target;
+    castling_rook(target_square, rook, rook_source, rook_target);
+
+    move_rook(pos, rook, rook_target, rook_source);
+  }
+}
+
+Move unpack_move(Position* pos, PackedMove packed) {
+  // return UNDEFINED_MOVE if no piece of the side to move stands on the source square
+  if (!packed) return UNDEFINED_MOVE;
+
+  Square source_square = Square(packed & 0x3f);
+  Square target_square = Square((packed & 0xfc0) >> 6);
+
+  Piece piece = pos->board[source_square];
+  if (!get_bit(pos->occupancies[pos->side], source_square)) return UNDEFINED_MOVE;
+
+  bool pawn = (piece == Piece::WP || piece == Piece::BP);
+  bool king = (piece == Piece::WK || piece == Piece::BK);
+
+  Piece promoted = (Piece)0;
+  if (pawn && (packed & 0x4000))
+    promoted = ((pos->side == Color::WHITE) ? WhitePromPiece : BlackPromPiece)[(packed & 0x3000) >> 12];
+
+  int capture_f = get_bit(pos->occupancies[~pos->side], target_square) ? 1 : 0;
+  int double_f = (pawn && std::abs(target_square - source_square) == 16) ? 1 : 0;
+  int enpassant_f = (pawn && target_square == pos->enpassant) ? 1 : 0;
+  int castling_f = (king && std::abs(target_square - source_square) == 2) ? 1 : 0;
+
+  return encode_move(source_square, target_square, piece, promoted, capture_f, double_f, enpassant_f, castling_f);
+}
+
+void make_null_move(Position* pos, UndoInfo& undo) {
+  undo.captured = Piece::NO_PIECE;
+  undo.enpassant = pos->enpassant;
+  undo.castle_rights = pos->castle_rights;
+  undo.halfmove_clock = pos->halfmove_clock;
+  undo.plies_from_null = pos->plies_from_null;
+  undo.hash_key = pos->hash_key;
+  undo.pawn_key = pos->pawn_key;
+  undo.material_key = pos->material_key;
+  undo.psqt = pos->psqt;
+  undo.phase = pos->phase;
+  undo.checkers = pos->checkers;
+  undo.pinned = pos->pinned;
+
+  pos->halfmove_clock++;
+  pos->plies_from_null = 0;
+
   pos->side = ~pos->side;
   pos->hash_key ^= side_key;
 
@@ -361,9 +542,23 @@ void make_null_move(Position* pos) {
     pos->enpassant = Square::NO_SQUARE;
   }
 
+  TT.prefetch(pos->hash_key);
+
   ++pos->ply;
-  ++pos->repetition_index;
-  pos->repetition_table[pos->repetition_index] = pos->hash_key;
+
+  set_check_info(pos);
+}
+
+void unmake_null_move(Position* pos, const UndoInfo& undo) {
+  --pos->ply;
+
+  pos->side = ~pos->side;
+  pos->enpassant = undo.enpassant;
+  pos->halfmove_clock = undo.halfmove_clock;
+  pos->plies_from_null = undo.plies_from_null;
+  pos->hash_key = undo.hash_key;
+  pos->checkers = undo.checkers;
+  pos->pinned = undo.pinned;
 }
 
 void print_board(Position* pos) {
@@ -375,13 +570,7 @@ void print_board(Position* pos) {
         std::cout << "  " << 8 - rank << " ";
       }
 
-      Piece piece = Piece::NO_PIECE;
-
-      for (Piece piece_bb = Piece::WP; piece_bb <= Piece::BK; ++piece_bb) {
-        if (get_bit(pos->bitboards[piece_bb], square)) {
-          piece = piece_bb; break;
-        }
-      }
+      Piece piece = pos->board[square];
       std::cout << " " << ((piece == Piece::NO_PIECE) ? '.' : ascii_pieces[piece]);
     }
     std::cout << '\n';
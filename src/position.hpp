@@ -1,42 +1,91 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "definition.hpp"
 #include "bitboard.hpp"
 
+// seed of the Zobrist keys, saved with the transposition table
+constexpr U64 zobrist_seed = 1804289383ULL;
+
+// maximum number of pieces of one type, with all pawns promoted
+constexpr int max_piece_count = 10;
+
 extern U64 piece_keys[12][64];
 extern U64 side_key;
+extern U64 no_pawns_key;
+extern U64 material_keys[PIECE_NB][max_piece_count];
 extern U64 enpassant_keys[64];
 extern U64 castle_keys[64];
 
+// state that make_move cannot recover from the move itself, restored by unmake_move
+struct UndoInfo {
+  Piece captured;
+  Square enpassant;
+  int castle_rights;
+  int halfmove_clock;
+  int plies_from_null;
+  U64 hash_key;
+  U64 pawn_key;
+  U64 material_key;
+  ScoreExt psqt;
+  Phase phase;
+  Bitboard checkers;
+  Bitboard pinned;
+};
+
+class NNUEState;
+
+// keys of the positions played in the game before the current one
+using KeyHistory = std::vector<U64>;
+
 class Position {
 public:
-  Position() = default;
-  explicit Position(Position* pos);
-
   Bitboard bitboards[PIECE_NB];
   Bitboard occupancies[OCCUPANCY_NB];
+  Piece board[SQUARE_NB];
 
   Color side;
   Square enpassant;
   int castle_rights;
 
   U64 hash_key;
-  U64 repetition_table[MAX_PLY_GAME];
-  int repetition_index;
+  U64 pawn_key;
+  U64 material_key;
+
+  int halfmove_clock;   // plies since the last capture or pawn move
+  int plies_from_null;  // plies since the last null move
 
   int ply;
   int piece_count[PIECE_NB];
 
+  // material and piece-square score, and non-pawn material, updated by make_move
+  ScoreExt psqt;
+  Phase phase;
+
+  // enemy pieces giving check and own pieces pinned to the king, for the side to move
+  Bitboard checkers;
+  Bitboard pinned;
+
+  // network accumulators updated by make_move and unmake_move, nullptr with the hand-crafted evaluation
+  NNUEState* nnue = nullptr;
+
   void set(const std::string& fenStr);
-  bool is_repetition();
 };
 
 bool is_square_attacked(Position* pos, Square square, Color side);
-bool make_move(Position* pos, Move move, Move_Type move_flag);
-void make_null_move(Position* pos);
+Bitboard attackers_to(Position* pos, Square square, Bitboard occupancy);
+void set_check_info(Position* pos);
+void make_move(Position* pos, Move move, UndoInfo& undo);
+void unmake_move(Position* pos, Move move, const UndoInfo& undo);
+void castling_rook(Square king_target, Piece& rook, Square& rook_source, Square& rook_target);
+Move unpack_move(Position* pos, PackedMove packed);
+void make_null_move(Position* pos, UndoInfo& undo);
+void unmake_null_move(Position* pos, const UndoInfo& undo);
 U64 generate_hash_key(Position* pos);
+U64 generate_pawn_key(Position* pos);
+U64 generate_material_key(Position* pos);
 void init_random_keys();
 void print_board(Position* pos);
 
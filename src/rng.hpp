@@ -4,11 +4,10 @@
 
 class RNG {
 public:
-  explicit RNG(unsigned int seed) : s(seed) { }
+  explicit RNG(U64 seed) : s(seed) { }
 
-  unsigned int s;
+  U64 s;
 
-  unsigned int rand32();
   U64 rand64();
 
   U64 magic_rand();
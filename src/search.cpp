@@ -3,17 +3,15 @@
 #include "bitboard.hpp"
 #include "movegen.hpp"
 #include "orderer.hpp"
+#include "see.hpp"
 #include "evaluate.hpp"
 #include "ttable.hpp"
 #include "timeman.hpp"
+#include "thread.hpp"
 
-#include <thread>
-#include <cstring>    // memset
 #include <iostream>
 #include <algorithm>  // std::min
 
-std::thread search_thread;
-ThreadData search_td;
 std::atomic<bool> search_stopped;
 
 inline void check_time(const SearchLimits& limits) {
@@ -23,35 +21,33 @@ inline void check_time(const SearchLimits& limits) {
     search_stopped = true;
   }
 }
-  
-void start_search(const Position& pos, int depth, const SearchLimits& limits) {
-  
-  // stop previous search
-  stop_search();
-
-  // ====== reset search data ======  
-  search_td.thread_id = 0;
-  search_td.depth = depth;
-  search_td.pos = pos;
 
-  search_td.nodes = 0;
+bool is_repetition(Position* pos, const ThreadData& td) {
+  // only positions since the last irreversible move with the same side to move can repeat
+  if (!pos->ply) return false;
 
-  memset(search_td.killer_moves, 0, sizeof(KillerMoves));
-  memset(search_td.history_moves, 0, sizeof(HistoryMoves));
-  memset(search_td.pv_length, 0, sizeof(search_td.pv_length));
-  memset(search_td.pv_table, 0, sizeof(search_td.pv_table));
+  int index = td.root_index + pos->ply;
+  int distance = std::min(std::min(pos->halfmove_clock, pos->plies_from_null), index);
 
-  search_td.limits = limits;
-  // ===============================
-
-  // start new search
-  search_stopped = false;
-  search_thread = std::thread(search_position, std::ref(search_td));
+  for (int back = 4; back <= distance; back += 2) {
+    if (td.key_history[index - back] == pos->hash_key)
+      return true;
+  }
+  return false;
 }
 
-void stop_search() {
-  search_stopped = true;
-  if (search_thread.joinable()) search_thread.join();
+Score static_evaluation(Position* pos, ThreadData& td) {
+  // evaluate the position unless it is found in the eval cache
+  Score eval;
+  if (td.eval_cache.probe(pos->hash_key, eval)) {
+    td.eval_stats.cache_hits++;
+    return eval;
+  }
+
+  eval = pos->nnue ? pos->nnue->evaluate(pos) : evaluate(pos, td.pawn_hash, td.material_hash);
+  td.eval_cache.store(pos->hash_key, eval);
+  td.eval_stats.evaluations++;
+  return eval;
 }
 
 Score quiescence(Position* pos, Score alpha, Score beta, ThreadData& td) {
@@ -60,32 +56,45 @@ Score quiescence(Position* pos, Score alpha, Score beta, ThreadData& td) {
     check_time(td.limits);
 
   // initialize TT entry
-  TTEntry tte;
+  TTData tte;
   Move previous_best_move = UNDEFINED_MOVE;
   Score score;
+  Score original_alpha = alpha;
   
   // probe TT
-  if (TT.probe(pos, tte)) {
+  bool tt_hit = TT.probe(pos, tte, td.tt_stats);
+  if (tt_hit) {
     if (tte.flag == ExactFlag) {
       score = tte.score;
 
       if (score < - MATE_IN_MAX_PLY) score += pos->ply;
       if (score > MATE_IN_MAX_PLY) score -= pos->ply;
+      td.tt_stats.cutoffs++;
       return score;
     }
     if ((tte.flag == UpperBound) &&  tte.score <= alpha) {
+      td.tt_stats.cutoffs++;
       return alpha;
     }
     if ((tte.flag == LowerBound) &&  tte.score >= beta) {
+      td.tt_stats.cutoffs++;
       return beta;
     }
     previous_best_move = tte.best_move;
   }
 
-  Score evaluation = evaluate(pos);
+  // static evaluation, from the TT entry if it holds one
+  Score evaluation;
+  if (tt_hit && tte.eval != NO_VALUE) {
+    evaluation = tte.eval;
+    td.eval_stats.tt_hits++;
+  }
+  else
+    evaluation = static_evaluation(pos, td);
 
   // fail-hard beta cutoff
   if (evaluation >= beta) {
+    if (!tt_hit) TT.write_entry(pos, LowerBound, beta, evaluation, DEPTH_QS, UNDEFINED_MOVE, td.tt_stats);
     return beta;
   }
 
@@ -98,23 +107,25 @@ Score quiescence(Position* pos, Score alpha, Score beta, ThreadData& td) {
     alpha = evaluation;
   }
 
-  // generate all moves
-  Orderer orderer = Orderer(pos, &td.killer_moves, &td.history_moves, previous_best_move);
+  // generate the captures and queen promotions
+  QuiescenceOrderer orderer = QuiescenceOrderer(pos, previous_best_move);
   Move current_move;
 
+  UndoInfo undo;
+
   while ((current_move = orderer.next_move()) != UNDEFINED_MOVE) {
-    Position next_pos = Position(pos);
+    // skip captures losing material
+    if (!see_ge(pos, current_move, 0)) continue;
 
-    // check if move is legal
-    if (!make_move(&next_pos, current_move, Move_Type::ONLY_CAPTURES))  {
-      continue;
-    }
+    make_move(pos, current_move, undo);
 
     // update node count
     td.nodes++;
   
     // recursive call
-    score = -quiescence(&next_pos, -beta, -alpha, td);
+    score = -quiescence(pos, -beta, -alpha, td);
+
+    unmake_move(pos, current_move, undo);
 
     // if the search was stopped, return NO_VALUE
     if (search_stopped) return NO_VALUE;
@@ -124,11 +135,15 @@ Score quiescence(Position* pos, Score alpha, Score beta, ThreadData& td) {
       alpha = score;
       // fail-hard beta cutoff
       if (score >= beta) {
+        if (!tt_hit) TT.write_entry(pos, LowerBound, beta, evaluation, DEPTH_QS, current_move, td.tt_stats);
         return beta;
       }
     }
 
   }
+
+  // store the result with the static evaluation, without replacing a searched entry
+  if (!tt_hit) TT.write_entry(pos, (alpha > original_alpha) ? ExactFlag : UpperBound, alpha, evaluation, DEPTH_QS, UNDEFINED_MOVE, td.tt_stats);
   return alpha;
 }
 
@@ -137,32 +152,48 @@ Score negamax(Position* pos, Score alpha, Score beta, int depth, bool null_pruni
   if((td.thread_id == 0) && ((td.nodes & check_every_nodes ) == 0))
     check_time(td.limits);
 
-  // check for draw
-  if (pos->is_repetition()) return DRAW_VALUE;
+  // if we search too deep, return static evaluation before writing past the ply indexed arrays
+  if (pos->ply > MAX_PLY_SEARCH - 1) {
+    td.pv_length[pos->ply] = pos->ply;
+    return static_evaluation(pos, td);
+  }
+
+  // push the key on the history and check for draw
+  td.key_history[td.root_index + pos->ply] = pos->hash_key;
+  if (is_repetition(pos, td)) return DRAW_VALUE;
+
+  // check for draw by insufficient material
+  if (pos->ply && probe_material(pos, td.material_hash)->draw) return DRAW_VALUE;
 
   // previous alpha value and PV node flag
   int pv_node = (beta - alpha) > 1;
   Score original_alpha = alpha;
 
   // initialize TT entry
-  TTEntry tte;
+  TTData tte;
   Move previous_best_move = UNDEFINED_MOVE;
+  Score evaluation = NO_VALUE;
   Score score;
 
   // probe TT
-  if (TT.probe(pos, tte)) {
+  if (TT.probe(pos, tte, td.tt_stats)) {
+    evaluation = tte.eval;
+
     if (pos->ply && tte.depth >= depth && !pv_node) {
       if (tte.flag == ExactFlag) {
         score = tte.score;
 
         if (score < - MATE_IN_MAX_PLY) score += pos->ply;
         if (score > MATE_IN_MAX_PLY) score -= pos->ply;
+        td.tt_stats.cutoffs++;
         return score;
       }
       if ((tte.flag == UpperBound) &&  tte.score <= alpha) {
+        td.tt_stats.cutoffs++;
         return alpha;
       }
       if ((tte.flag == LowerBound) &&  tte.score >= beta) {
+        td.tt_stats.cutoffs++;
         return beta;
       }
     }
@@ -173,9 +204,7 @@ Score negamax(Position* pos, Score alpha, Score beta, int depth, bool null_pruni
   td.pv_length[pos->ply] = pos->ply;
 
   // check if king is in check
-  bool in_check = is_square_attacked(pos, (pos->side == Color::WHITE) ? get_lsb_index(pos->bitboards[Piece::WK]) :
-                                                                get_lsb_index(pos->bitboards[Piece::BK]),
-                                                                ~pos->side);
+  bool in_check = pos->checkers;
 
   // increase search depth if king has been exposed to check
   if (in_check)
@@ -185,16 +214,14 @@ Score negamax(Position* pos, Score alpha, Score beta, int depth, bool null_pruni
   if (depth == 0)
     return quiescence(pos, alpha, beta, td);
 
-  // static evaluation
-  if (pos->ply > MAX_PLY_SEARCH - 1)
-    return evaluate(pos);
-
   // null move pruning
   if (null_pruning && pos->ply && depth > null_move_reduction && !pv_node && !in_check) {
-    Position next_pos = Position(pos);
-    make_null_move(&next_pos);
+    UndoInfo undo;
+    make_null_move(pos, undo);
+
+    score = -negamax(pos, -beta, -beta + 1, depth - null_move_reduction, false, td);
 
-    score = -negamax(&next_pos, -beta, -beta + 1, depth - null_move_reduction, false, td);
+    unmake_null_move(pos, undo);
 
     if (score >= beta) {
       return beta;
@@ -212,40 +239,38 @@ Score negamax(Position* pos, Score alpha, Score beta, int depth, bool null_pruni
   Move current_move;
 
   bool lmr = !in_check && depth > lmr_reduction;
+  UndoInfo undo;
 
   while ((current_move = orderer.next_move()) != UNDEFINED_MOVE) {
-    Position next_pos = Position(pos);
-
-    // check if move is legal
-    if (!make_move(&next_pos, current_move, Move_Type::ALL_MOVES)) {
-      continue;
-    }
+    make_move(pos, current_move, undo);
 
     // update node counts
     td.nodes++;
     legal_moves++;
 
     // full depth search
-    if (moves_searched == 0) score = -negamax(&next_pos, -beta, -alpha, depth - 1, true, td); // full depth search
+    if (moves_searched == 0) score = -negamax(pos, -beta, -alpha, depth - 1, true, td); // full depth search
     // late move reduction (LMR)
     else {
       // condition to consider LMR
       if(lmr && (moves_searched >= full_depth_moves) && (get_move_capture_f(current_move) == 0) && (get_move_promoted(current_move) == 0)) {
         // search current move with reduced depth:
-        score = -negamax(&next_pos, -alpha - 1, -alpha, depth - lmr_reduction, true, td);
+        score = -negamax(pos, -alpha - 1, -alpha, depth - lmr_reduction, true, td);
       }
       else score = alpha + 1; // fail-soft to trigger PVS
 
       // Principal Variation Search (PVS)
       if(score > alpha)
       {
-        score = -negamax(&next_pos, -alpha - 1, -alpha, depth-1, true, td);
+        score = -negamax(pos, -alpha - 1, -alpha, depth-1, true, td);
   
       if((score > alpha) && (score < beta))
-        score = -negamax(&next_pos, -beta, -alpha, depth-1, true, td);
+        score = -negamax(pos, -beta, -alpha, depth-1, true, td);
       }
     }
 
+    unmake_move(pos, current_move, undo);
+
     // update number of moves searched
     moves_searched++;
 
@@ -300,7 +325,7 @@ Score negamax(Position* pos, Score alpha, Score beta, int depth, bool null_pruni
   // update TT entry
   TTFlag tt_flag = (best_score >= beta) ? LowerBound : (alpha > original_alpha) ? ExactFlag : UpperBound;
   Score return_score = (best_score >= beta) ? beta : (alpha > original_alpha) ? best_score  : alpha;
-  TT.write_entry(pos, tt_flag, return_score, depth, best_move);
+  TT.write_entry(pos, tt_flag, return_score, evaluation, depth, best_move, td.tt_stats);
 
   return return_score;
 }
@@ -359,30 +384,40 @@ void search_position(ThreadData& td) {
   Position* pos = &td.pos;
   pos->ply = 0;
 
-  Move bestmove = UNDEFINED_MOVE;
   Score score = NO_VALUE;
 
 
   // iterative deepening
   for (int current_depth = 1; current_depth <= td.depth; current_depth++) {
+    // helper threads skip some depths so that they do not all search the same tree
+    if (td.thread_id) {
+      int skip_idx = (td.thread_id - 1) % skip_size_nb;
+      if (((current_depth + skip_phase[skip_idx]) / skip_size[skip_idx]) % 2)
+        continue;
+    }
+
     score = aspiration_window(pos, score, current_depth, td);
 
     // if the search was stopped, break
     if (search_stopped) break;
 
     // retrieve best move
-    bestmove = td.pv_table[0][0];
+    td.completed_depth = current_depth;
+    td.best_score = score;
+    td.best_move = td.pv_table[0][0];
     
     // print info on the main thread
     if (td.thread_id == 0) {
+      NodeCounter nodes = Threads.nodes_searched();
+
       if (score > -MATE_VALUE && score < -MATE_IN_MAX_PLY) {
-        std::cout << "info score mate " << -(score + MATE_VALUE) / 2 - 1 << " depth " << current_depth << " nodes " << td.nodes << " time " << get_time_ms() - top_time << " pv ";
+        std::cout << "info score mate " << -(score + MATE_VALUE) / 2 - 1 << " depth " << current_depth << " nodes " << nodes << " time " << get_time_ms() - top_time << " hashfull " << TT.hashfull() << " pv ";
       }
       else if (score > MATE_IN_MAX_PLY && score < MATE_VALUE) {
-        std::cout << "info score mate " << (MATE_VALUE - score) / 2 + 1 << " depth " << current_depth << " nodes " << td.nodes << " time " << get_time_ms() - top_time << " pv ";
+        std::cout << "info score mate " << (MATE_VALUE - score) / 2 + 1 << " depth " << current_depth << " nodes " << nodes << " time " << get_time_ms() - top_time << " hashfull " << TT.hashfull() << " pv ";
       }  
       else
-        std::cout << "info score cp " << score << " depth " << current_depth << " nodes " << td.nodes << " time " << get_time_ms() - top_time << " pv ";
+        std::cout << "info score cp " << score << " depth " << current_depth << " nodes " << nodes << " time " << get_time_ms() - top_time << " hashfull " << TT.hashfull() << " pv ";
 
       for (int count = 0; count < td.pv_length[0]; count++) {
         print_move(td.pv_table[0][count]);
@@ -397,12 +432,16 @@ void search_position(ThreadData& td) {
       break;
   }
 
-  // print best move
-  if (td.thread_id == 0) {
-    std::cout << "bestmove ";
-    print_move(bestmove);
-    std::cout << '\n';
-    std::cout << std::flush;
-  }
-}
+  if (td.thread_id != 0)
+    return;
+
+  // stop the helper threads and wait for them to finish
+  search_stopped = true;
+  Threads.wait_helpers();
 
+  // print best move
+  std::cout << "bestmove ";
+  print_move(Threads.best_thread().best_move);
+  std::cout << '\n';
+  std::cout << std::flush;
+}
\ No newline at end of file
@@ -4,6 +4,11 @@
 #include "position.hpp"
 #include "move.hpp"
 #include "timeman.hpp"
+#include "ttable.hpp"
+#include "pawns.hpp"
+#include "material.hpp"
+#include "evalcache.hpp"
+#include "nnue.hpp"
 
 #include <atomic>
 
@@ -14,19 +19,35 @@ struct ThreadData {
   int depth;
   Position pos;
 
+  // keys of the game positions followed by the keys of the search stack, indexed by root_index + ply
+  U64 key_history[MAX_PLY_GAME + MAX_PLY_SEARCH]{};
+  int root_index = 0;
+
   NodeCounter nodes = 0;
 
   KillerMoves killer_moves{};
   HistoryMoves history_moves{};
-  int pv_length[MAX_PLY_SEARCH]{};
+  int pv_length[MAX_PLY_SEARCH + 1]{};   // the parent of the deepest node reads its length
   Move pv_table[MAX_PLY_SEARCH][MAX_PLY_SEARCH]{};
 
   SearchLimits limits;
+
+  TTStats tt_stats;
+  PawnTable pawn_hash;
+  MaterialTable material_hash;
+  EvalCache eval_cache;
+  EvalStats eval_stats;
+  NNUEState nnue;
+
+  // result of the last completed iteration, used to pick the best thread
+  int completed_depth = 0;
+  Score best_score = NO_VALUE;
+  Move best_move = UNDEFINED_MOVE;
 };
 
-void start_search(const Position& pos, int depth, const SearchLimits& limits);
-void stop_search();
 
+bool is_repetition(Position* pos, const ThreadData& td);
+Score static_evaluation(Position* pos, ThreadData& td);
 Score quiescence(Position* pos, Score alpha, Score beta, ThreadData& td);
 Score negamax(Position* pos, Score alpha, Score beta, int depth, bool null_pruning, ThreadData& td);
 Score aspiration_window(Position* pos, Score previous_score, int depth, ThreadData& td);
@@ -34,6 +55,10 @@ Score aspiration_window(Position* pos, Score previous_score, int depth, ThreadDa
 void search_position(ThreadData& td);
 constexpr int check_every_nodes = 2046;
 
+// === Threads ===
+constexpr int default_threads = 1;
+constexpr int max_threads = 256;
+
 // =========== search hyperparameters ===========
 // === LMR ===
 constexpr int full_depth_moves = 4;
@@ -48,6 +73,11 @@ constexpr Score aspiration_window_start = 150;
 constexpr Score aspiration_window_decrement = 0;
 constexpr Score aspiration_window_end = 10;
 constexpr Score aspiration_window_max = 350;
+
+// === Lazy SMP depth staggering === // from Stockfish (9)
+constexpr int skip_size_nb = 20;
+constexpr int skip_size[skip_size_nb]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+constexpr int skip_phase[skip_size_nb] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
 // ===============================================
 
 
@@ -0,0 +1,80 @@
+#include "see.hpp"
+
+#include "bitboard.hpp"
+#include "move.hpp"
+
+bool see_ge(Position* pos, Move move, int threshold) {
+  // true if the exchange sequence started by the move wins at least threshold, both sides capturing
+  // with their least valuable attacker and being free to stop, sliders behind a capturer join the sequence
+  if (get_move_castling_f(move) || get_move_promoted(move))
+    return 0 >= threshold;
+
+  Square source_square = get_move_source(move);
+  Square target_square = get_move_target(move);
+  Bitboard occupancy = pos->occupancies[Color::BOTH] ^ (1ULL << source_square);
+
+  Piece captured = pos->board[target_square];
+  if (get_move_enpassant_f(move)) {
+    captured = (pos->side == Color::WHITE) ? Piece::BP : Piece::WP;
+    occupancy ^= 1ULL << ((pos->side == Color::WHITE) ? shift<Direction::DOWN>(target_square) : shift<Direction::UP>(target_square));
+  }
+
+  // balance after the move, then after the recapture of the moving piece
+  int swap = ((captured != Piece::NO_PIECE) ? see_values[captured] : 0) - threshold;
+  if (swap < 0) return false;
+
+  swap = see_values[get_move_piece(move)] - swap;
+  if (swap <= 0) return true;
+
+  Bitboard bishops = pos->bitboards[Piece::WB] | pos->bitboards[Piece::BB] | pos->bitboards[Piece::WQ] | pos->bitboards[Piece::BQ];
+  Bitboard rooks = pos->bitboards[Piece::WR] | pos->bitboards[Piece::BR] | pos->bitboards[Piece::WQ] | pos->bitboards[Piece::BQ];
+
+  Bitboard attackers = attackers_to(pos, target_square, occupancy) & occupancy;
+  Color side = pos->side;
+  bool result = true;
+
+  for (;;) {
+    side = ~side;
+    attackers &= occupancy;
+
+    Bitboard side_attackers = attackers & pos->occupancies[side];
+    if (!side_attackers) break;
+
+    result = !result;
+
+    // least valuable attacker of the side, its removal may uncover a slider behind it
+    const Bitboard* pieces = &pos->bitboards[(side == Color::WHITE) ? Piece::WP : Piece::BP];
+    Bitboard attacker;
+
+    if ((attacker = side_attackers & pieces[0])) {
+      if ((swap = see_values[Piece::WP] - swap) < result) break;
+      occupancy ^= attacker & (~attacker + 1);
+      attackers |= get_bishop_attacks(target_square, occupancy) & bishops;
+    }
+    else if ((attacker = side_attackers & pieces[1])) {
+      if ((swap = see_values[Piece::WN] - swap) < result) break;
+      occupancy ^= attacker & (~attacker + 1);
+    }
+    else if ((attacker = side_attackers & pieces[2])) {
+      if ((swap = see_values[Piece::WB] - swap) < result) break;
+      occupancy ^= attacker & (~attacker + 1);
+      attackers |= get_bishop_attacks(target_square, occupancy) & bishops;
+    }
+    else if ((attacker = side_attackers & pieces[3])) {
+      if ((swap = see_values[Piece::WR] - swap) < result) break;
+      occupancy ^= attacker & (~attacker + 1);
+      attackers |= get_rook_attacks(target_square, occupancy) & rooks;
+    }
+    else if ((attacker = side_attackers & pieces[4])) {
+      if ((swap = see_values[Piece::WQ] - swap) < result) break;
+      occupancy ^= attacker & (~attacker + 1);
+      attackers |= (get_bishop_attacks(target_square, occupancy) & bishops) | (get_rook_attacks(target_square, occupancy) & rooks);
+    }
+    else {
+      // the king can only capture last, when the other side has no attacker left
+      return (attackers & ~pos->occupancies[side]) ? !result : result;
+    }
+  }
+
+  return result;
+}
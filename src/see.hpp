@@ -0,0 +1,9 @@
+#pragma once
+
+#include "definition.hpp"
+#include "position.hpp"
+
+// piece values of the static exchange evaluation, the king is never captured
+constexpr int see_values[PIECE_NB] = { 100, 300, 300, 500, 900, 0, 100, 300, 300, 500, 900, 0 };
+
+bool see_ge(Position* pos, Move move, int threshold);
@@ -0,0 +1,168 @@
+#include "thread.hpp"
+
+#include "ttable.hpp"
+
+#include <algorithm>  // std::min std::copy
+#include <cstring>    // memset
+
+ThreadPool Threads;
+
+SearchThread::SearchThread(int thread_id) : native_thread(&SearchThread::idle_loop, this) {
+  td.thread_id = thread_id;
+  wait_for_search_finished();
+}
+
+SearchThread::~SearchThread() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    exit = true;
+    searching = true;
+  }
+  cv.notify_all();
+  native_thread.join();
+}
+
+void SearchThread::idle_loop() {
+  for (;;) {
+    std::unique_lock<std::mutex> lock(mutex);
+    searching = false;
+    cv.notify_all();
+    cv.wait(lock, [&] { return searching; });
+
+    if (exit) return;
+
+    lock.unlock();
+    search_position(td);
+  }
+}
+
+void SearchThread::start_searching() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    searching = true;
+  }
+  cv.notify_all();
+}
+
+void SearchThread::wait_for_search_finished() {
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return !searching; });
+}
+
+ThreadPool::~ThreadPool() {
+  set(0);
+}
+
+void ThreadPool::set(int count) {
+  stop_search();
+
+  // workers are only created or destroyed here, never between searches
+  threads.clear();
+  for (int thread_id = 0; thread_id < count; thread_id++)
+    threads.push_back(std::make_unique<SearchThread>(thread_id));
+}
+
+void ThreadPool::start_search(const Position& pos, const KeyHistory& history, int depth, const SearchLimits& limits) {
+
+  // stop previous search
+  stop_search();
+
+  // ====== reset search data ======
+  for (auto& thread : threads) {
+    ThreadData& td = thread->td;
+
+    td.depth = depth;
+    td.pos = pos;
+
+    // keep the most recent game keys, older ones are beyond any fifty move window
+    td.root_index = std::min(int(history.size()), MAX_PLY_GAME);
+    std::copy(history.end() - td.root_index, history.end(), td.key_history);
+
+    td.nodes = 0;
+    td.tt_stats = {};
+    td.eval_stats = {};
+
+    // the accumulators follow the search position, the refresh cache is rebuilt from it
+    td.pos.nnue = nnue_active() ? &td.nnue : nullptr;
+    if (td.pos.nnue) td.nnue.reset(&td.pos);
+
+    memset(td.killer_moves, 0, sizeof(KillerMoves));
+    memset(td.history_moves, 0, sizeof(HistoryMoves));
+    memset(td.pv_length, 0, sizeof(td.pv_length));
+    memset(td.pv_table, 0, sizeof(td.pv_table));
+
+    td.limits = limits;
+
+    td.completed_depth = 0;
+    td.best_score = NO_VALUE;
+    td.best_move = UNDEFINED_MOVE;
+  }
+  // ===============================
+
+  TT.new_search();
+
+  // wake up the helpers before the main thread, which waits for them before reporting the best move:
+  // a helper still parked when the main thread finishes would start after the bestmove
+  search_stopped = false;
+  for (size_t idx = 1; idx < threads.size(); idx++)
+    threads[idx]->start_searching();
+  if (!threads.empty())
+    threads.front()->start_searching();
+}
+
+void ThreadPool::stop_search() {
+  search_stopped = true;
+  wait_search();
+}
+
+void ThreadPool::wait_search() {
+  for (auto& thread : threads)
+    thread->wait_for_search_finished();
+}
+
+void ThreadPool::wait_helpers() {
+  for (size_t idx = 1; idx < threads.size(); idx++)
+    threads[idx]->wait_for_search_finished();
+}
+
+void ThreadPool::clear_eval_caches() {
+  // cached evaluations are stale once the evaluation function changes
+  stop_search();
+  for (auto& thread : threads)
+    thread->td.eval_cache.clear();
+}
+
+NodeCounter ThreadPool::nodes_searched() const {
+  NodeCounter nodes = 0;
+  for (const auto& thread : threads)
+    nodes += thread->td.nodes;
+  return nodes;
+}
+
+TTStats ThreadPool::tt_stats() const {
+  TTStats stats;
+  for (const auto& thread : threads)
+    stats += thread->td.tt_stats;
+  return stats;
+}
+
+EvalStats ThreadPool::eval_stats() const {
+  EvalStats stats;
+  for (const auto& thread : threads)
+    stats += thread->td.eval_stats;
+  return stats;
+}
+
+ThreadData& ThreadPool::best_thread() {
+  // the thread that completed the deepest iteration, the best score among equally deep ones,
+  // the main thread on a full tie
+  ThreadData* best_td = &threads.front()->td;
+
+  for (auto& thread : threads) {
+    ThreadData& td = thread->td;
+    if (td.completed_depth > best_td->completed_depth
+        || (td.completed_depth == best_td->completed_depth && td.best_score > best_td->best_score))
+      best_td = &td;
+  }
+  return *best_td;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "definition.hpp"
+#include "position.hpp"
+#include "search.hpp"
+#include "timeman.hpp"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// worker owning its search data, parked on a condition variable between searches
+class SearchThread {
+public:
+  explicit SearchThread(int thread_id);
+  ~SearchThread();
+
+  void idle_loop();
+  void start_searching();
+  void wait_for_search_finished();
+
+  ThreadData td;
+
+private:
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool searching = true;
+  bool exit = false;
+  std::thread native_thread;
+};
+
+class ThreadPool {
+public:
+  ~ThreadPool();
+
+  void set(int count);
+  void start_search(const Position& pos, const KeyHistory& history, int depth, const SearchLimits& limits);
+  void stop_search();
+  void wait_search();
+  void wait_helpers();
+  void clear_eval_caches();
+
+  int size() const { return int(threads.size()); }
+
+  NodeCounter nodes_searched() const;
+  TTStats tt_stats() const;
+  EvalStats eval_stats() const;
+  ThreadData& best_thread();
+
+private:
+  std::vector<std::unique_ptr<SearchThread>> threads;
+};
+
+extern ThreadPool Threads;
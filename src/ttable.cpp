@@ -1,36 +1,339 @@
 #include "ttable.hpp"
 
-#include <cstring>    // memset
+#include "move.hpp"
+#include "nnue.hpp"
+
+#include <algorithm>  // std::min
+#include <bit>        // std::bit_cast
+#include <climits>    // INT32_MAX
+#include <cstring>    // memset memcpy memcmp
+#include <fstream>
+#include <iostream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap munmap madvise
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close
+#endif
 
 TranspositionTable TT;
 
+uint16_t key16_of(U64 key) {
+  return uint16_t(key >> 48);
+}
+
+uint16_t check16(U64 data) {
+  return uint16_t(data ^ (data >> 16) ^ (data >> 32) ^ (data >> 48));
+}
+
+TTStats& operator+=(TTStats& s1, const TTStats& s2) {
+  s1.probes += s2.probes;
+  s1.hits += s2.hits;
+  s1.cutoffs += s2.cutoffs;
+  s1.overwrites += s2.overwrites;
+  s1.collisions += s2.collisions;
+  return s1;
+}
+
+TranspositionTable::~TranspositionTable() {
+  free_table();
+}
+
+void TranspositionTable::free_table() {
+  if (table != &fallback_bucket)
+    large_page_free(table, bucket_count * sizeof(TTBucket), table_page_type);
+  table = nullptr;
+  bucket_count = 0;
+}
+
+void TranspositionTable::resize(size_t mb_size) {
+  // round the number of buckets down to a power of two
+  size_t new_count = 1;
+  while (2 * new_count * sizeof(TTBucket) <= mb_size * 1024 * 1024)
+    new_count *= 2;
+
+  allocate(new_count);
+  clear();
+}
+
+bool TranspositionTable::allocate(size_t new_count) {
+  // free the old table first so that both are never allocated at the same time,
+  // the size is halved until an allocation succeeds
+  free_table();
+
+  for (size_t count = new_count; count; count /= 2) {
+    table = static_cast<TTBucket*>(large_page_alloc(count * sizeof(TTBucket), table_page_type));
+    if (!table) continue;
+
+    if (count != new_count)
+      std::cout << "info string error: failed to allocate " << new_count * sizeof(TTBucket) / (1024 * 1024)
+                << "MB for the transposition table, using " << count * sizeof(TTBucket) / (1024 * 1024) << "MB" << std::endl;
+
+    bucket_count = count;
+    index_mask = count - 1;
+    return count == new_count;
+  }
+
+  // out of memory, a single bucket keeps the engine running
+  std::cout << "info string error: failed to allocate the transposition table, using a single bucket" << std::endl;
+  table = &fallback_bucket;
+  table_page_type = Page_Type::NORMAL_PAGES;
+  bucket_count = 1;
+  index_mask = 0;
+  return false;
+}
+
 void TranspositionTable::clear() {
-  memset(this, 0, sizeof(TranspositionTable));
+  memset(static_cast<void*>(table), 0, bucket_count * sizeof(TTBucket));
+  generation8 = 0;
+}
+
+int TranspositionTable::hashfull() const {
+  // permill of the entries written or found during the current search, sampled on the first buckets
+  size_t sample = std::min(hashfull_sample, bucket_count);
+  size_t used = 0;
+
+  for (size_t bucket_idx = 0; bucket_idx < sample; bucket_idx++) {
+    for (int idx = 0; idx < bucket_size; idx++) {
+      TTEntry entry = std::bit_cast<TTEntry>(table[bucket_idx].data[idx].load(std::memory_order_relaxed));
+      if ((entry.gen_bound8 & ~generation_mask) && (entry.gen_bound8 & generation_mask) == generation8)
+        used++;
+    }
+  }
+  return int(used * 1000 / (sample * bucket_size));
+}
+
+void TranspositionTable::print_stats() const {
+  constexpr int depth_nb = 256;
+  constexpr int flag_nb = 4;
+  constexpr int age_nb = 64;
+  constexpr char const * flag_names[flag_nb] = { "none", "exact", "upper", "lower" };
+
+  NodeCounter depths[depth_nb] = {};
+  NodeCounter flags[flag_nb] = {};
+  NodeCounter ages[age_nb] = {};
+  NodeCounter used = 0;
+
+  for (size_t bucket_idx = 0; bucket_idx < bucket_count; bucket_idx++) {
+    for (int idx = 0; idx < bucket_size; idx++) {
+      TTEntry entry = std::bit_cast<TTEntry>(table[bucket_idx].data[idx].load(std::memory_order_relaxed));
+      int flag = entry.gen_bound8 & ~generation_mask;
+
+      flags[flag]++;
+      if (!flag) continue;
+
+      used++;
+      depths[entry.depth8]++;
+      ages[age(entry)]++;
+    }
+  }
+
+  NodeCounter total = NodeCounter(bucket_count) * bucket_size;
+
+  std::cout << "\n Transposition table\n\n";
+  std::cout << "    Size:        " << bucket_count * sizeof(TTBucket) / (1024 * 1024) << "MB, " << bucket_count << " buckets of " << bucket_size << " entries\n";
+  std::cout << "    Pages:       " << page_type_name(table_page_type) << '\n';
+  std::cout << "    Generation:  " << generation8 / generation_delta << '\n';
+  std::cout << "    Used:        " << used << " / " << total << " (" << 1000 * used / total << " permill)\n";
+  std::cout << "    Hashfull:    " << hashfull() << " permill\n";
+
+  std::cout << "\n    Flag histogram\n";
+  for (int flag = 0; flag < flag_nb; flag++)
+    std::cout << "      " << flag_names[flag] << ": " << flags[flag] << '\n';
+
+  std::cout << "\n    Depth histogram\n";
+  for (int depth = 0; depth < depth_nb; depth++)
+    if (depths[depth]) std::cout << "      " << depth + DEPTH_QS << ": " << depths[depth] << '\n';
+
+  std::cout << "\n    Age histogram (searches)\n";
+  for (int entry_age = 0; entry_age < age_nb; entry_age++)
+    if (ages[entry_age]) std::cout << "      " << entry_age << ": " << ages[entry_age] << '\n';
+
+  std::cout << std::flush;
+}
+
+TTFileHeader TranspositionTable::file_header() const {
+  TTFileHeader header = {};
+
+  memcpy(header.magic, tt_file_magic, sizeof(header.magic));
+  header.version = tt_file_version;
+  header.bucket_bytes = sizeof(TTBucket);
+  header.entries_per_bucket = bucket_size;
+  header.generation8 = generation8;
+  header.zobrist_seed = zobrist_seed;
+  header.zobrist_check = side_key;
+  header.bucket_count = bucket_count;
+  header.eval_id = eval_id();
+
+  return header;
+}
+
+bool TranspositionTable::save(const std::string& path) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+
+  TTFileHeader header = file_header();
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(table), bucket_count * sizeof(TTBucket));
+
+  return bool(file);
+}
+
+bool TranspositionTable::load(const std::string& path) {
+#if defined(_WIN32)
+  // memory mapped files are only supported on POSIX systems
+  (void)path;
+  return false;
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || size_t(file_stat.st_size) < sizeof(TTFileHeader)) {
+    close(fd);
+    return false;
+  }
+
+  size_t file_size = file_stat.st_size;
+  void* map = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+
+  // check that the file was written by a compatible engine
+  TTFileHeader header;
+  memcpy(&header, map, sizeof(header));
+
+  TTFileHeader expected = file_header();
+  bool compatible = memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+                 && header.version == expected.version
+                 && header.bucket_bytes == expected.bucket_bytes
+                 && header.entries_per_bucket == expected.entries_per_bucket
+                 && header.zobrist_seed == expected.zobrist_seed
+                 && header.zobrist_check == expected.zobrist_check
+                 && header.eval_id == expected.eval_id
+                 && header.bucket_count && (header.bucket_count & (header.bucket_count - 1)) == 0
+                 // bounded before the multiplication, which could otherwise wrap to the file size
+                 && header.bucket_count <= (file_size - sizeof(header)) / sizeof(TTBucket)
+                 && header.bucket_count <= size_t(max_hash_size) * 1024 * 1024 / sizeof(TTBucket)
+                 && file_size == sizeof(header) + header.bucket_count * sizeof(TTBucket);
+
+  if (!compatible) {
+    munmap(map, file_size);
+    return false;
+  }
+
+  // the table takes the size of the saved one
+  if (header.bucket_count != bucket_count && !allocate(header.bucket_count)) {
+    clear();
+    munmap(map, file_size);
+    return false;
+  }
+
+  madvise(map, file_size, MADV_SEQUENTIAL);
+  memcpy(static_cast<void*>(table), static_cast<const char*>(map) + sizeof(header), bucket_count * sizeof(TTBucket));
+  generation8 = uint8_t(header.generation8);
+
+  munmap(map, file_size);
+  return true;
+#endif
 }
 
-bool TranspositionTable::probe(Position* pos, TTEntry& tte) {
+void TranspositionTable::new_search() {
+  // entries written during previous searches age out
+  generation8 += generation_delta;
+}
+
+bool TranspositionTable::probe(Position* pos, TTData& tte, TTStats& stats) {
   // return true if the position is found in the table
+  stats.probes++;
+
+  TTBucket* hash_bucket = bucket(pos->hash_key);
+  uint16_t key16 = key16_of(pos->hash_key);
+
+  for (int idx = 0; idx < bucket_size; idx++) {
+    U64 data = hash_bucket->data[idx].load(std::memory_order_relaxed);
+    uint16_t key = hash_bucket->keys[idx].load(std::memory_order_relaxed);
+
+    // check if the partial key matches an occupied entry
+    if ((key ^ check16(data)) != key16) continue;
+
+    TTEntry entry = std::bit_cast<TTEntry>(data);
+    if (!(entry.gen_bound8 & ~generation_mask)) continue;
+
+    // refresh the entry so that it is not replaced as an old one
+    if ((entry.gen_bound8 & generation_mask) != generation8) {
+      TTEntry refreshed = entry;
+      refreshed.gen_bound8 = generation8 | (entry.gen_bound8 & ~generation_mask);
+      store(hash_bucket, idx, key16, refreshed);
+    }
 
-  // retrieve the entry from the table and set it to tte
-  tte = table[pos->hash_key % hash_size];
+    // unpack the entry and set it to tte
+    tte.best_move = unpack_move(pos, entry.move16);
+    tte.score = entry.score16;
+    tte.eval = entry.eval16;
+    tte.depth = entry.depth8 + DEPTH_QS;
+    tte.flag = TTFlag(entry.gen_bound8 & ~generation_mask);
 
-  // check if the hash key matches
-  if (tte.key == pos->hash_key)
+    stats.hits++;
+    if (entry.move16 && tte.best_move == UNDEFINED_MOVE)
+      stats.collisions++;
     return true;
+  }
   return false;
 }
 
-void TranspositionTable::write_entry(Position* pos, TTFlag flag, Score score, int depth, Move move) {
-  // always replace scheme
-  TTEntry *hash_entry = &table[pos->hash_key % hash_size];
+void TranspositionTable::write_entry(Position* pos, TTFlag flag, Score score, Score eval, int depth, Move move, TTStats& stats) {
+  TTBucket* hash_bucket = bucket(pos->hash_key);
+  uint16_t key16 = key16_of(pos->hash_key);
+
+  // replace the entry of the same position, otherwise the shallowest and oldest one
+  int replace_idx = 0;
+  int replace_weight = INT32_MAX;
+  bool overwrite = false;
+  for (int idx = 0; idx < bucket_size; idx++) {
+    U64 data = hash_bucket->data[idx].load(std::memory_order_relaxed);
+    uint16_t key = hash_bucket->keys[idx].load(std::memory_order_relaxed);
+
+    if ((key ^ check16(data)) == key16) {
+      replace_idx = idx;
+      overwrite = false;
+
+      // keep the static evaluation of the position if the new entry has none
+      TTEntry entry = std::bit_cast<TTEntry>(data);
+      if (eval == NO_VALUE && (entry.gen_bound8 & ~generation_mask))
+        eval = entry.eval16;
+      break;
+    }
+
+    TTEntry entry = std::bit_cast<TTEntry>(data);
+    int weight = entry.depth8 - age_weight * age(entry);
+    if (weight < replace_weight) {
+      replace_idx = idx;
+      replace_weight = weight;
+      overwrite = entry.gen_bound8 & ~generation_mask;
+    }
+  }
+
+  if (overwrite)
+    stats.overwrites++;
 
   // store mate score independently of distance to root node
   if (score <= -MATE_IN_MAX_PLY) score -= pos->ply;
   if (score >= MATE_IN_MAX_PLY) score += pos->ply;
 
-  hash_entry->key = pos->hash_key;
-  hash_entry->depth = depth;
-  hash_entry->flag = flag;
-  hash_entry->score = score;
-  hash_entry->best_move = move;
-}
\ No newline at end of file
+  TTEntry entry;
+  entry.depth8 = uint8_t(depth - DEPTH_QS);
+  entry.gen_bound8 = generation8 | flag;
+  entry.score16 = int16_t(score);
+  entry.move16 = pack_move(move);
+  entry.eval16 = int16_t(eval);
+
+  store(hash_bucket, replace_idx, key16, entry);
+}
+
+void TranspositionTable::store(TTBucket* hash_bucket, int idx, uint16_t key16, const TTEntry& entry) {
+  U64 data = std::bit_cast<U64>(entry);
+  hash_bucket->data[idx].store(data, std::memory_order_relaxed);
+  hash_bucket->keys[idx].store(key16 ^ check16(data), std::memory_order_relaxed);
+}
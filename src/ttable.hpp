@@ -2,26 +2,142 @@
 
 #include "definition.hpp"
 #include "position.hpp"
+#include "memory.hpp"
 
-constexpr int hash_size = 800000;
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
 
-enum TTFlag : int { ExactFlag, UpperBound, LowerBound };
+// hash size in MB
+constexpr int default_hash_size = 16;
+constexpr int max_hash_size = 65536;
 
+enum TTFlag : uint8_t { NoFlag, ExactFlag, UpperBound, LowerBound };
+
+// depth of the entries written by the quiescence search, below any negamax depth
+// so that they never cut a negamax node (in check, it still has the evasions to search)
+constexpr int DEPTH_QS = -1;
+
+/* packed entry (10 bytes), stored as a 16-bit key and a 64-bit data word
+
+  key16        upper 16 bits of the hash key, the lower bits select the bucket
+  depth8       depth to get value, stored as depth - DEPTH_QS
+  gen_bound8   generation (6 upper bits) and flag (2 lower bits)
+  score16      score (beta/alpha/PV)
+  move16       best move found (see pack_move)
+  eval16       static evaluation
+
+  Lock-free access: each field is read and written with a single relaxed atomic
+  operation and the stored key is key16 ^ check16(data). A key and a data word
+  coming from two different writes fail the key check, so torn entries are
+  seen as misses instead of wrong scores.
+*/
 struct TTEntry {
-  U64 key;        // hash key of position
-  int depth;      // depth to get value
-  TTFlag flag;    // flag for the type of node (fail-high/fail-low/PV)
-  Score score;    // score (beta/alpha/PV)
-  Move best_move; // best move found
+  uint8_t depth8;
+  uint8_t gen_bound8;
+  int16_t score16;
+  PackedMove move16;
+  int16_t eval16;
+};
+
+// unpacked entry returned to the search
+struct TTData {
+  Move best_move;
+  Score score;
+  Score eval;
+  int depth;
+  TTFlag flag;
+};
+
+// per-search counters, kept by each search thread
+struct TTStats {
+  NodeCounter probes = 0;
+  NodeCounter hits = 0;
+  NodeCounter cutoffs = 0;
+  NodeCounter overwrites = 0;   // writes evicting an entry of another position
+  NodeCounter collisions = 0;   // hits whose move is not valid in the probed position
+};
+
+TTStats& operator+=(TTStats& s1, const TTStats& s2);
+
+// a bucket fills exactly one cache line so that a probe touches a single line
+constexpr int cache_line_size = 64;
+constexpr int bucket_size = cache_line_size / (sizeof(uint16_t) + sizeof(U64));
+
+struct alignas(cache_line_size) TTBucket {
+  std::atomic<U64> data[bucket_size];
+  std::atomic<uint16_t> keys[bucket_size];
+};
+
+static_assert(sizeof(TTEntry) == sizeof(U64), "TTEntry must fit in the data word");
+static_assert(sizeof(TTBucket) == cache_line_size, "TTBucket must fill one cache line");
+static_assert(std::atomic<U64>::is_always_lock_free, "TT data words must be lock-free");
+
+// the generation is stored above the 2 flag bits
+constexpr uint8_t generation_delta = 1 << 2;
+constexpr int generation_cycle = 255 + generation_delta;
+constexpr uint8_t generation_mask = 0xFC;
+
+// number of buckets sampled to compute hashfull
+constexpr size_t hashfull_sample = 1000;
+
+// replacement weight of the age of an entry compared to its depth
+constexpr int age_weight = 8;
+
+// header of a saved table, files written with another layout or other Zobrist keys are rejected
+constexpr char tt_file_magic[8] = "TCEHASH";
+constexpr uint32_t tt_file_version = 3;
+
+struct TTFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t bucket_bytes;        // entry layout: bucket size in bytes
+  uint32_t entries_per_bucket;  // entry layout: number of entries in a bucket
+  uint32_t generation8;
+  U64 zobrist_seed;
+  U64 zobrist_check;            // side key, detects a change in the key generation
+  U64 bucket_count;
+  U64 eval_id;                  // evaluation of the stored static evals, see eval_id()
 };
 
 class TranspositionTable {
 public:
-  TTEntry table[hash_size];
+  ~TranspositionTable();
 
-  bool probe(Position* pos, TTEntry& tte);
-  void write_entry(Position* pos, TTFlag flag, Score score, int depth, Move move);
+  bool probe(Position* pos, TTData& tte, TTStats& stats);
+  void write_entry(Position* pos, TTFlag flag, Score score, Score eval, int depth, Move move, TTStats& stats);
+  void prefetch(U64 key) { __builtin_prefetch(bucket(key)); }
+  void new_search();
+  void resize(size_t mb_size);
   void clear();
+
+  int hashfull() const;
+  void print_stats() const;
+
+  bool save(const std::string& path);
+  bool load(const std::string& path);
+
+  Page_Type page_type() const { return table_page_type; }
+
+private:
+  TTBucket* table = nullptr;
+  size_t bucket_count = 0;
+  Page_Type table_page_type = Page_Type::NORMAL_PAGES;
+  U64 index_mask = 0;   // bucket_count is a power of two, so the index is the low bits of the key
+  uint8_t generation8 = 0;
+  TTBucket fallback_bucket;   // used when no table can be allocated
+
+  bool allocate(size_t new_count);
+  void free_table();
+  TTFileHeader file_header() const;
+
+  TTBucket* bucket(U64 key) { return &table[key & index_mask]; }
+  void store(TTBucket* hash_bucket, int idx, uint16_t key16, const TTEntry& entry);
+  int age(const TTEntry& tte) const { return ((generation_cycle + generation8 - tte.gen_bound8) & generation_mask) / generation_delta; }
 };
 
+uint16_t key16_of(U64 key);
+uint16_t check16(U64 data);
+
 extern TranspositionTable TT;
@@ -4,13 +4,17 @@
 #include "movegen.hpp"
 #include "move.hpp"
 #include "search.hpp"
+#include "thread.hpp"
 #include "bench.hpp"
 #include "definition.hpp"
 #include "ttable.hpp"
+#include "nnue.hpp"
+#include "perft.hpp"
 
 #include <string>
 #include <cstring>   // strncmp
 #include <iostream>
+#include <algorithm> // std::clamp
 
 Move parse_move(Position* pos, std::string move_string) {
 
@@ -45,7 +49,7 @@ Move parse_move(Position* pos, std::string move_string) {
   return UNDEFINED_MOVE;  
 }
 
-void parse_position(Position& pos, std::istringstream& ss, bool& position_set) {
+void parse_position(Position& pos, KeyHistory& history, std::istringstream& ss, bool& position_set) {
 
   std::string token, fen;
   ss >> token;
@@ -64,17 +68,20 @@ void parse_position(Position& pos, std::istringstream& ss, bool& position_set) {
   }
 
   pos.set(fen);
+  history.clear();
 
   if (token == "moves") {
     Move move;
+    UndoInfo undo;
     while (ss >> token && (move = parse_move(&pos, token)) != UNDEFINED_MOVE) {
-      make_move(&pos, move, Move_Type::ALL_MOVES);
+      history.push_back(pos.hash_key);
+      make_move(&pos, move, undo);
     }
   }
   position_set = true;
 }
 
-void parse_go(Position& pos, std::istringstream& ss, const bool& position_set) {
+void parse_go(Position& pos, const KeyHistory& history, std::istringstream& ss, const bool& position_set) {
 
   if (!position_set) {
     std::cout << "info string error: position not set" << std::endl;
@@ -88,7 +95,19 @@ void parse_go(Position& pos, std::istringstream& ss, const bool& position_set) {
   int depth;
   
   while (ss >> token) {
-    if (token == "wtime") ss >> limits.remaining_times[Color::WHITE];
+    if (token == "perft") {
+      int perft_depth = 0;
+      ss >> perft_depth;
+      if (perft_depth < 1) {
+        std::cout << "info string error: invalid perft depth" << std::endl;
+        return;
+      }
+      // perft runs on this thread, a running search is stopped first
+      Threads.stop_search();
+      perft_test(&pos, perft_depth, Threads.size());
+      return;
+    }
+    else if (token == "wtime") ss >> limits.remaining_times[Color::WHITE];
     else if (token == "btime") ss >> limits.remaining_times[Color::BLACK];
     else if (token == "winc") ss >> limits.incs[Color::WHITE];
     else if (token == "binc") ss >> limits.incs[Color::BLACK];
@@ -107,7 +126,135 @@ void parse_go(Position& pos, std::istringstream& ss, const bool& position_set) {
     depth = limits.depth ? limits.depth : MAX_PLY_SEARCH;
   }
 
-  start_search(pos, depth, limits);
+  Threads.start_search(pos, history, depth, limits);
+}
+
+void parse_setoption(std::istringstream& ss) {
+
+  std::string token, name, value;
+  ss >> token;
+
+  if (token != "name") {
+    std::cout << "info string error: invalid command" << std::endl;
+    return;
+  }
+
+  while (ss >> token && token != "value")
+    name += (name.empty() ? "" : " ") + token;
+  while (ss >> token)
+    value += (value.empty() ? "" : " ") + token;
+
+  std::istringstream value_ss(value);
+
+  if (name == "Threads") {
+    int threads = default_threads;
+    value_ss >> threads;
+    Threads.set(std::clamp(threads, 1, max_threads));
+  }
+  else if (name == "Hash") {
+    int hash_size = default_hash_size;
+    value_ss >> hash_size;
+    Threads.stop_search();
+    TT.resize(std::clamp(hash_size, 1, max_hash_size));
+    std::cout << "info string transposition table on " << page_type_name(TT.page_type()) << std::endl;
+  }
+  else if (name == "PerftHash") {
+    int hash_size = default_perft_hash_size;
+    value_ss >> hash_size;
+    PerftTT.resize(std::clamp(hash_size, 0, max_perft_hash_size));
+  }
+  else if (name == "EvalFile") {
+    Threads.stop_search();
+    if (nnue_load(value)) std::cout << "info string network loaded from " << value << std::endl;
+    else                  std::cout << "info string error: could not load a compatible network from " << value << std::endl;
+    TT.clear();
+    Threads.clear_eval_caches();
+  }
+  else if (name == "UseNNUE") {
+    Threads.stop_search();
+    nnue_enabled = (value == "true");
+    if (nnue_enabled && !nnue_loaded)
+      std::cout << "info string error: no network loaded, using the hand-crafted evaluation" << std::endl;
+    TT.clear();
+    Threads.clear_eval_caches();
+  }
+  else
+    std::cout << "info string error: unknown option " << name << std::endl;
+}
+
+void parse_hash_file(std::istringstream& ss, bool save) {
+
+  std::string path;
+  std::getline(ss >> std::ws, path);
+
+  if (path.empty()) {
+    std::cout << "info string error: missing file name" << std::endl;
+    return;
+  }
+
+  Threads.stop_search();
+
+  if (save) {
+    if (TT.save(path)) std::cout << "info string hash saved to " << path << std::endl;
+    else               std::cout << "info string error: could not write " << path << std::endl;
+  }
+  else {
+    if (TT.load(path)) std::cout << "info string hash loaded from " << path << std::endl;
+    else               std::cout << "info string error: could not load a compatible hash file from " << path << std::endl;
+  }
+}
+
+void parse_tt(std::istringstream& ss) {
+
+  std::string token;
+  ss >> token;
+
+  if (token != "stats") {
+    std::cout << "info string error: invalid command" << std::endl;
+    return;
+  }
+
+  // a running search is stopped, an infinite one would never let the command return
+  Threads.stop_search();
+  TT.print_stats();
+
+  TTStats stats = Threads.tt_stats();
+  std::cout << "\n    Last search\n";
+  std::cout << "      probes:     " << stats.probes << '\n';
+  std::cout << "      hits:       " << stats.hits << " (" << (stats.probes ? 1000 * stats.hits / stats.probes : 0) << " permill)\n";
+  std::cout << "      cutoffs:    " << stats.cutoffs << '\n';
+  std::cout << "      overwrites: " << stats.overwrites << '\n';
+  std::cout << "      collisions: " << stats.collisions << '\n';
+
+  EvalStats eval_stats = Threads.eval_stats();
+  std::cout << "\n    Static evaluations\n";
+  std::cout << "      evaluate:   " << eval_stats.evaluations << '\n';
+  std::cout << "      cache hits: " << eval_stats.cache_hits << '\n';
+  std::cout << "      tt hits:    " << eval_stats.tt_hits << '\n' << std::endl;
+}
+
+void parse_perft_suite(std::istringstream& ss) {
+
+  std::string path;
+  int max_depth = MAX_PLY_SEARCH;
+
+  if (!(ss >> path)) {
+    std::cout << "info string error: missing file name" << std::endl;
+    return;
+  }
+  ss >> max_depth;
+
+  // the suite runs on this thread, a running search is stopped first
+  Threads.stop_search();
+  perft_suite(path, max_depth, Threads.size());
+}
+
+void print_options() {
+  std::cout << "option name Hash type spin default " << default_hash_size << " min 1 max " << max_hash_size << '\n';
+  std::cout << "option name Threads type spin default " << default_threads << " min 1 max " << max_threads << '\n';
+  std::cout << "option name PerftHash type spin default " << default_perft_hash_size << " min 0 max " << max_perft_hash_size << '\n';
+  std::cout << "option name EvalFile type string default " << nnue_default_file << '\n';
+  std::cout << "option name UseNNUE type check default true\n";
 }
 
 void uci_loop(int argc, char* argv[]) {
@@ -117,6 +264,7 @@ void uci_loop(int argc, char* argv[]) {
   }
 
   Position pos;
+  KeyHistory history;
   bool position_set = false;
   std::string cmd;
 
@@ -130,14 +278,23 @@ void uci_loop(int argc, char* argv[]) {
     ss >> std::skipws >> token;
 
     if (token == "quit")            break;
-    else if (token == "stop")       stop_search();
-    else if (token == "uci")        std::cout << "id name TCE\nid author Thomas Lemercier\nuciok\n";
+    else if (token == "stop")       Threads.stop_search();
+    else if (token == "uci") {
+      std::cout << "id name TCE\nid author Thomas Lemercier\n";
+      print_options();
+      std::cout << "uciok\n";
+    }
     else if (token == "isready")    std::cout << "readyok\n";
     else if (token == "ucinewgame") TT.clear();
-    else if (token == "position")   parse_position(pos, ss, position_set);
-    else if (token == "go")         parse_go(pos, ss, position_set);
+    else if (token == "setoption")  parse_setoption(ss);
+    else if (token == "position")   parse_position(pos, history, ss, position_set);
+    else if (token == "go")         parse_go(pos, history, ss, position_set);
     else if (token == "bench")      bench();
+    else if (token == "tt")         parse_tt(ss);
+    else if (token == "savehash")   parse_hash_file(ss, true);
+    else if (token == "loadhash")   parse_hash_file(ss, false);
+    else if (token == "perftsuite") parse_perft_suite(ss);
   }
 
-  stop_search();
+  Threads.stop_search();
 }
\ No newline at end of file
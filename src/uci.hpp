@@ -6,6 +6,11 @@
 #include "position.hpp"
 
 Move parse_move(Position* pos, std::string move_string);
-void parse_position(Position& pos, std::istringstream& ss, bool& position_set);
-void parse_go(Position& pos, std::istringstream& ss, const bool& position_set);
+void parse_position(Position& pos, KeyHistory& history, std::istringstream& ss, bool& position_set);
+void parse_go(Position& pos, const KeyHistory& history, std::istringstream& ss, const bool& position_set);
+void parse_setoption(std::istringstream& ss);
+void parse_hash_file(std::istringstream& ss, bool save);
+void parse_tt(std::istringstream& ss);
+void parse_perft_suite(std::istringstream& ss);
+void print_options();
 void uci_loop(int argc, char* argv[]);